@@ -10,12 +10,12 @@ input=$3
 output=$4
 
 # CSV header
-echo "nw,C++ Threads (Static),C++ Threads (Dynamic),FastFlow (Static),FastFlow (Dynamic),Ideal"
+echo "nw,C++ Threads (Static),C++ Threads (Dynamic),FastFlow (Static),FastFlow (Dynamic),C++ Threads (Work Stealing),Ideal"
 
 # Sequential computation
 seq=$(for ((i=1;i<10;i++)); do ./prudence_threads_static 0 $h $input $output; done | awk '{sum += $2} END {print sum/NR}')
 # Prints the first row of the CSV
-echo "0,,,$seq"
+echo "0,,,,,,$seq"
 # Varies the number of workers
 for ((nw=1;nw<nw_max+1;nw*=2)); do
     # Time of the C++ Threads implementation
@@ -24,8 +24,10 @@ for ((nw=1;nw<nw_max+1;nw*=2)); do
     # Time of the FastFlow implementation
     ffs_time=$(for ((i=1;i<10;i++)); do ./prudence_fastflow_static $nw $h $input $output; done | awk '{sum += $2} END {print sum/NR}')
     ffd_time=$(for ((i=1;i<10;i++)); do ./prudence_fastflow_dynamic $nw $h $input $output; done | awk '{sum += $2} END {print sum/NR}')
+    # Time of the work stealing implementation
+    cws_time=$(for ((i=1;i<10;i++)); do ./prudence_threads_ws $nw $h $input $output; done | awk '{sum += $2} END {print sum/NR}')
     # Ideal time (seq / nw)
     id_time=$(bc -l <<< $seq/$nw)
     # Prints the CSV row
-    echo "$nw,$cts_time,$ctd_time,$ffs_time,$ffd_time,$id_time"
+    echo "$nw,$cts_time,$ctd_time,$ffs_time,$ffd_time,$cws_time,$id_time"
 done
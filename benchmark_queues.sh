@@ -0,0 +1,24 @@
+#!/bin/bash
+
+# Maximum number of workers
+nw_max=$1
+# Background knowledge size, h = 1, ..., 5
+h=$2
+# Input file path
+input=$3
+# Output file path
+output=$4
+
+# CSV header
+echo "nw,Time (Mutex),t_E (Mutex),Handoff (Mutex),Time (Lock-free),t_E (Lock-free),Handoff (Lock-free)"
+
+# Averages time, emitter service time and handoff time of the dynamic farm with the given queue
+measure() {
+    for ((i=1;i<10;i++)); do ./prudence_threads_dynamic $nw $h $input $output --queue=$1; done \
+        | awk '{time += $2; emitter += $7; handoff += $10} END {printf "%f,%f,%f", time/NR, emitter/NR, handoff/NR}'
+}
+
+# Varies the number of workers
+for ((nw=1;nw<nw_max+1;nw*=2)); do
+    echo "$nw,$(measure mutex),$(measure lockfree)"
+done
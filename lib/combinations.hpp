@@ -1,6 +1,8 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <vector>
 
 /**
@@ -27,11 +29,49 @@ public:
         mask.resize(n, 0);
         i = 0;
     }
+    /**
+     * @brief Construct a new combinations object starting from the combination with the given
+     * rank, in the order followed by next() (lexicographic on the selected indices).
+     * 
+     * @param n Total number of items.
+     * @param k Size of the combination, at most n.
+     * @param rank Rank of the first combination, less than binomial(n, k).
+     */
+    CombinationsEnumerator(int n, int k, uint64_t rank) {
+        mask = std::vector<bool>(n, 0);
+        // Chooses the selected indices one by one, skipping the blocks of combinations before the rank
+        for (int p = 0, c = 0; p < k; p++, c++) {
+            while (rank >= binomial(n - c - 1, k - p - 1)) {
+                rank -= binomial(n - c - 1, k - p - 1);
+                c++;
+            }
+            mask[c] = 1;
+        }
+        i = 0;
+    }
+
     /**
      * @brief Destroy the combinations object
      */
     ~CombinationsEnumerator() {}
 
+    /**
+     * @brief Number of combinations of k items out of n, saturated to UINT64_MAX.
+     */
+    static uint64_t binomial(int n, int k) {
+        if (k < 0 || k > n)
+            return 0;
+        k = std::min(k, n - k);
+        uint64_t result = 1;
+        for (int j = 1; j <= k; j++) {
+            // result * (n - k + j) / j is exact, as it is binomial(n - k + j, j)
+            if (result > UINT64_MAX / (n - k + j))
+                return UINT64_MAX;
+            result = result * (n - k + j) / j;
+        }
+        return result;
+    }
+
     /**
      * @brief Gets the next permutation
      * 
@@ -42,4 +82,143 @@ public:
         i++;
         return std::prev_permutation(mask.begin(), mask.end());
     }
-};
\ No newline at end of file
+};
+
+/**
+ * @brief Iterator over every combination of H numbers in {0 ... n - 1}, in lexicographic order,
+ * given as the array of the selected indices. Requires n <= 256.
+ * 
+ * @tparam H Size of the combination.
+ */
+template <size_t H>
+class FixedCombinationsEnumerator {
+public:
+    // Selected indices, in increasing order
+    std::array<uint8_t, H> indices;
+    // Total number of items
+    int n;
+    // Index of the current combination
+    int i;
+
+    /**
+     * @brief Construct a new fixed combinations object
+     * 
+     * @param _n Total number of items, at least H.
+     */
+    FixedCombinationsEnumerator(int _n): n(_n), i(0) {
+        for (size_t k = 0; k < H; k++)
+            indices[k] = k;
+    }
+
+    /**
+     * @brief Gets the next combination
+     * 
+     * @return true If the combination is not the last one.
+     * @return false If the combination is the last one.
+     */
+    bool next() {
+        i++;
+        // Rightmost index that can still be incremented
+        size_t k = H;
+        while (k > 0 && indices[k - 1] == n - H + k - 1)
+            k--;
+        if (k == 0)
+            return false;
+        indices[k - 1]++;
+        for (size_t l = k; l < H; l++)
+            indices[l] = indices[l - 1] + 1;
+        return true;
+    }
+};
+
+/**
+ * @brief Iterator over every combination of k numbers in {0 ... n - 1} in revolving-door order
+ * (Knuth, TAOCP 7.2.1.3, Algorithm R): every step removes exactly one number and adds another.
+ * The first combination is {0 ... k - 1}.
+ */
+class RevolvingDoorEnumerator {
+private:
+    // Selected numbers in increasing order, 1-based, followed by the sentinels n and n + 1
+    std::vector<int> c;
+    // Total number of items
+    int n;
+    // Size of the combination
+    int k;
+public:
+    // Number removed by the last step
+    int removed = -1;
+    // Number added by the last step
+    int added = -1;
+
+    /**
+     * @brief Construct a new revolving door object
+     * 
+     * @param _n Total number of items.
+     * @param _k Size of the combination, a larger one selects all the n items like CombinationsEnumerator.
+     */
+    RevolvingDoorEnumerator(int _n, int _k): c(std::min(_k, _n) + 3), n(_n), k(std::min(_k, _n)) {
+        for (int j = 1; j <= k; j++)
+            c[j] = j - 1;
+        c[k + 1] = n;
+        c[k + 2] = n + 1;
+    }
+
+    /**
+     * @brief Selected number in position p, from 0 to k - 1, in increasing order.
+     */
+    int operator[](const int& p) const {
+        return c[p + 1];
+    }
+
+    /**
+     * @brief Moves to the next combination, setting removed and added.
+     * 
+     * @return true If the combination is not the last one.
+     * @return false If the combination is the last one.
+     */
+    bool next() {
+        if (k == 0 || k >= n)
+            return false;
+        // Easy case: the smallest number moves by one
+        if (k % 2 == 1 && c[1] + 1 < c[2]) {
+            removed = c[1];
+            added = ++c[1];
+            return true;
+        }
+        if (k % 2 == 0 && c[1] > 0) {
+            removed = c[1];
+            added = --c[1];
+            return true;
+        }
+        if (k == 1)
+            return false;
+        int j = 2;
+        // An odd k tries to decrease c[2] first (step R4), an even k to increase it (step R5)
+        bool decrease = k % 2 == 1;
+        while (true) {
+            if (decrease) {
+                // Here c[j] = c[j - 1] + 1
+                if (c[j] >= j) {
+                    removed = c[j];
+                    added = j - 2;
+                    c[j] = c[j - 1];
+                    c[j - 1] = j - 2;
+                    return true;
+                }
+                j++;
+            }
+            // Here c[j - 1] = j - 2
+            if (c[j] + 1 < c[j + 1]) {
+                removed = j - 2;
+                added = c[j] + 1;
+                c[j - 1] = c[j];
+                c[j]++;
+                return true;
+            }
+            j++;
+            if (j > k)
+                return false;
+            decrease = true;
+        }
+    }
+};
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <chrono>
+#include <thread>
 #include <vector>
 
+#include <lock_free_queue.hpp>
 #include <safe_queue.hpp>
-#include <prudence/utils.hpp>
+#include <prudence/checkpoint.hpp>
+#include <prudence/engine.hpp>
+#include <prudence/schedule.hpp>
 
 /**
  * @brief Chunk of indices in an array
@@ -19,38 +24,69 @@ struct chunk_t {
  */
 using thread_id = short;
 
+/**
+ * @brief Overheads of the farm, measured in microseconds.
+ */
+struct farm_stats_t {
+    // Average time spent by the emitter to serve a request (t_E)
+    double emitter = 0;
+    // Average time from a request of a worker to the arrival of its chunk
+    double handoff = 0;
+};
+
 
 /**
  * @brief Emitter that dinamically assigns slices to the workers via queues and feedback queue.
  * 
+ * @tparam Queue Type of the queues to the workers.
+ * @tparam FeedbackQueue Type of the feedback queue.
  * @param queues Queues from the emitter to each worker.
  * @param feedback_queue Feedback queue from the workers to the emitter.
  * @param n Number of records in the dataset.
+ * @param guided If true the chunks shrink with the remaining records, otherwise they are fixed.
+ * @param service If not null, receives the average time in microseconds spent serving a request.
+ * @param checkpoint If not null, n counts its unfinished users and the chunks are mapped to their indices.
  */
+template <typename Queue, typename FeedbackQueue>
 void emitter(
-    std::vector<SafeQueue<std::optional<chunk_t>>>& queues,
-    SafeQueue<thread_id>& feedback_queue,
-    const size_t& n
+    std::vector<Queue>& queues,
+    FeedbackQueue& feedback_queue,
+    const size_t& n,
+    const bool& guided = false,
+    double* service = nullptr,
+    const prudence::Checkpoint* checkpoint = nullptr
 ) {
     // Number of workers in the dataset
     short nw = queues.size();
     // Decides the chunk size (half of n/nw)
-    size_t chunk_size{n / (2 * nw)};
+    size_t chunk_size{std::max<size_t>(1, n / (2 * nw))};
+    // Size of the chunk starting at begin
+    auto next_size = [&](const size_t& begin) {
+        return guided ? prudence::guided_chunk_size(n - begin, nw) : std::min(chunk_size, n - begin);
+    };
+    // Index of the user at a position
+    auto index = [&checkpoint](const size_t& position) {
+        return checkpoint ? checkpoint->index(position) : position;
+    };
     // Begin of the current chunk
     size_t begin = 0;
     // End of the current chunk
-    size_t end = std::min(chunk_size, n);
+    size_t end = next_size(0);
     // Assigns the first chunks
     for (thread_id i = 0; i < nw; i++) {
-        chunk_t chunk = { begin, end};
+        chunk_t chunk = { index(begin), index(end) };
         queues[i].push(std::move(chunk));
         begin = end;
-        end = std::min(begin + chunk_size, n);
+        end = begin + next_size(begin);
     }
+    // Time spent serving the requests and number of requests
+    std::chrono::steady_clock::duration busy{0};
+    size_t requests = 0;
     // Waits for requests from the users
     while (nw > 0) {
         // Gets a new thread ID
         thread_id tid = feedback_queue.pop();
+        auto start = std::chrono::steady_clock::now();
         // If begin is equal to n we don't have any more chunks to dispatch
         if (begin == n) {
             // Pushes the EOS
@@ -60,41 +96,53 @@ void emitter(
         }
         else {
             // Chunk to send into the queue
-            chunk_t chunk = { begin, end };
+            chunk_t chunk = { index(begin), index(end) };
             // Sends data into the queue
             queues[tid].push(std::move(chunk));
             // Increments begin
             begin = end;
             // Increments end based on the new value of begin
-            end = std::min(begin + chunk_size, n);
+            end = begin + next_size(begin);
         }
+        busy += std::chrono::steady_clock::now() - start;
+        requests++;
     }
+    if (service)
+        *service = std::chrono::duration<double, std::micro>(busy).count() / std::max<size_t>(requests, 1);
 }
 
 /**
  * @brief Worker that computes risks on the given chunks.
  * 
- * @param dataset Global view of the dataset.
+ * @tparam Queue Type of the queue from the emitter.
+ * @tparam FeedbackQueue Type of the feedback queue.
+ * @param id Identifier of the worker.
+ * @param engine Engine that computes the risk.
  * @param risk_vector Vector in wich to put the risk values.
  * @param queue Queue to get chunks.
  * @param feedback_queue Feedback queue to request new chunks.
- * @param h Background knowledge size.
- * @param eps Margin for the matching computation.
  */
+template <typename Queue, typename FeedbackQueue>
 void worker(
     const thread_id& id,
-    std::vector<prudence::Record>& dataset,
+    const prudence::Engine& engine,
     std::vector<float>& risk_vector,
-    SafeQueue<std::optional<chunk_t>>& queue,
-    SafeQueue<thread_id>& feedback_queue,
-    const short& h,
-    const float& eps
+    Queue& queue,
+    FeedbackQueue& feedback_queue,
+    double* handoff = nullptr
 ) {
+    // Time spent waiting for the chunks after a request and number of requests
+    std::chrono::steady_clock::duration waiting{0};
+    size_t requests = 0;
+    // Time of the last request
+    auto requested = std::chrono::steady_clock::now();
     // Flag that signals that the thread is running
     bool running = true;
     while (running) {
         // Gets the chunk
         std::optional<chunk_t> data = queue.pop();
+        if (requests > 0)
+            waiting += std::chrono::steady_clock::now() - requested;
         // If an EOS is received, terminate
         if (!data)
             running = false;
@@ -102,12 +150,67 @@ void worker(
             // Chunk to compute
             chunk_t chunk = data.value();
             // Computes the risk on a chunk
-            for (size_t i = chunk.begin; i < chunk.end; i++) {
-                float risk = prudence::assess_risk(dataset[i], dataset, h, eps);
-                risk_vector[i] = risk;
-            }
+            engine.assess_range(chunk.begin, chunk.end, risk_vector.data() + chunk.begin * engine.width());
             // Requests the next chunk
+            requested = std::chrono::steady_clock::now();
+            requests++;
             feedback_queue.push(id);
         }
     }
+    if (handoff)
+        *handoff = std::chrono::duration<double, std::micro>(waiting).count() / std::max<size_t>(requests, 1);
+}
+
+/**
+ * @brief Runs the farm: spawns the workers, runs the emitter on the calling thread and joins them.
+ * 
+ * @tparam Queue Type of the queues to the workers.
+ * @tparam FeedbackQueue Type of the feedback queue.
+ * @param engine Engine that computes the risk.
+ * @param risk_vector Vector in wich to put the risk values.
+ * @param nw Number of workers.
+ * @param guided If true the chunks shrink with the remaining records, otherwise they are fixed.
+ * @param checkpoint If not null, only its unfinished users are handed out.
+ * @return farm_stats_t Overheads of the emitter and of the queues.
+ */
+template <typename Queue, typename FeedbackQueue>
+farm_stats_t farm(
+    const prudence::Engine& engine,
+    std::vector<float>& risk_vector,
+    const short& nw,
+    const bool& guided = false,
+    const prudence::Checkpoint* checkpoint = nullptr
+) {
+    // Vector of queues
+    std::vector<Queue> queues(nw);
+    // Feedback queue
+    FeedbackQueue feedback_queue;
+    // Vector of threads
+    std::vector<std::thread> worker_threads(nw);
+    // Handoff time of each worker
+    std::vector<double> handoffs(nw);
+    farm_stats_t stats;
+    for (thread_id i = 0; i < nw; i++) {
+        // Worker thread
+        std::thread worker_thread(
+            worker<Queue, FeedbackQueue>,
+            i,
+            std::cref(engine),
+            std::ref(risk_vector),
+            std::ref(queues[i]),
+            std::ref(feedback_queue),
+            &handoffs[i]
+        );
+        worker_threads[i] = std::move(worker_thread);
+    }
+    // Number of users to hand out
+    size_t n = checkpoint ? checkpoint->unfinished() : risk_vector.size() / engine.width();
+    // To spare a thread, the main thread becomes the emitter
+    emitter(queues, feedback_queue, n, guided, &stats.emitter, checkpoint);
+    // Joins all the entities
+    for (std::thread& w: worker_threads)
+        w.join();
+    for (double h: handoffs)
+        stats.handoff += h / nw;
+    return stats;
 }
\ No newline at end of file
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Lets a thread wait for a condition, spinning for a while before blocking.
+ * The waker only pays for a notification when someone is actually blocked.
+ */
+class Parker {
+private:
+    // Number of polls before yielding
+    static constexpr int SPINS = 1 << 10;
+    // Number of yields before blocking
+    static constexpr int YIELDS = 1 << 4;
+    std::mutex mut;
+    std::condition_variable cond;
+    // Number of threads blocked on the condition variable
+    std::atomic<int> sleepers{0};
+public:
+    /**
+     * @brief Waits until the predicate becomes true.
+     * 
+     * @tparam Predicate Callable returning bool, safe to call concurrently with the waker.
+     * @param ready Predicate to wait for.
+     */
+    template <typename Predicate>
+    void wait(Predicate ready) {
+        for (int i = 0; i < SPINS; i++)
+            if (ready())
+                return;
+        for (int i = 0; i < YIELDS; i++) {
+            if (ready())
+                return;
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(mut);
+        // Announces the sleeper before checking again, so that a waker can't miss it
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cond.wait(lock, ready);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Wakes the blocked threads, if any. Must be called after the state that makes
+     * the predicate true has been published.
+     */
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0) {
+            // Taking the lock orders the notification after the check of the sleeper
+            { std::lock_guard<std::mutex> lock(mut); }
+            cond.notify_all();
+        }
+    }
+};
+
+/**
+ * @brief Bounded lock-free queue with a single producer and a single consumer.
+ * Same interface of SafeQueue: push waits while the queue is full, pop while it's empty.
+ * 
+ * @tparam T Type of the items passed into the queue, default constructible.
+ * @tparam Capacity Maximum number of items in the queue, a power of two.
+ */
+template <typename T, size_t Capacity = 64>
+class SpscQueue {
+private:
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    // Ring buffer of the items
+    T buffer[Capacity];
+    // Index of the next item to pop, written by the consumer
+    alignas(64) std::atomic<size_t> head{0};
+    // Index of the next item to push, written by the producer
+    alignas(64) std::atomic<size_t> tail{0};
+    // Waiting consumer, on empty
+    Parker not_empty;
+    // Waiting producer, on full
+    Parker not_full;
+public:
+    /**
+     * @brief Pushes a new value in the queue.
+     * 
+     * @param value Value to push in the queue.
+     */
+    void push(T const& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        not_full.wait([&]{ return t - head.load(std::memory_order_acquire) < Capacity; });
+        buffer[t & (Capacity - 1)] = value;
+        tail.store(t + 1, std::memory_order_release);
+        not_empty.wake();
+    }
+
+    /**
+     * @brief Waits until the queue is non-empty, then gets an element.
+     * 
+     * @return T Element popped from the queue.
+     */
+    T pop() {
+        size_t h = head.load(std::memory_order_relaxed);
+        not_empty.wait([&]{ return tail.load(std::memory_order_acquire) != h; });
+        T result(std::move(buffer[h & (Capacity - 1)]));
+        head.store(h + 1, std::memory_order_release);
+        not_full.wake();
+        return result;
+    }
+};
+
+/**
+ * @brief Bounded lock-free queue with many producers and a single consumer.
+ * Every cell carries a sequence number telling whether it is free for the producer that
+ * claimed its position or full for the consumer.
+ * Same interface of SafeQueue: push waits while the queue is full, pop while it's empty.
+ * 
+ * @tparam T Type of the items passed into the queue, default constructible.
+ * @tparam Capacity Maximum number of items in the queue, a power of two.
+ */
+template <typename T, size_t Capacity = 1024>
+class MpscQueue {
+private:
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    /**
+     * @brief Item of the ring buffer with its sequence number.
+     */
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+    // Ring buffer of the items
+    Cell buffer[Capacity];
+    // Index of the next item to pop, owned by the consumer
+    alignas(64) size_t head{0};
+    // Index of the next position to claim, shared by the producers
+    alignas(64) std::atomic<size_t> tail{0};
+    // Waiting consumer, on empty
+    Parker not_empty;
+    // Waiting producers, on full
+    Parker not_full;
+public:
+    /**
+     * @brief Construct a new MPSC queue object, with every cell free for its first round.
+     */
+    MpscQueue() {
+        for (size_t i = 0; i < Capacity; i++)
+            buffer[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Pushes a new value in the queue.
+     * 
+     * @param value Value to push in the queue.
+     */
+    void push(T const& value) {
+        // Claims a position
+        size_t t = tail.fetch_add(1, std::memory_order_relaxed);
+        Cell& cell = buffer[t & (Capacity - 1)];
+        // Waits until the consumer has freed the cell from the previous round
+        not_full.wait([&]{ return cell.sequence.load(std::memory_order_acquire) == t; });
+        cell.value = value;
+        cell.sequence.store(t + 1, std::memory_order_release);
+        not_empty.wake();
+    }
+
+    /**
+     * @brief Waits until the queue is non-empty, then gets an element.
+     * 
+     * @return T Element popped from the queue.
+     */
+    T pop() {
+        Cell& cell = buffer[head & (Capacity - 1)];
+        size_t h = head;
+        not_empty.wait([&]{ return cell.sequence.load(std::memory_order_acquire) == h + 1; });
+        T result(std::move(cell.value));
+        // Frees the cell for the next round
+        cell.sequence.store(h + Capacity, std::memory_order_release);
+        head = h + 1;
+        not_full.wake();
+        return result;
+    }
+};
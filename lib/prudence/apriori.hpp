@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+#include <prudence/bitset.hpp>
+
+namespace prudence {
+    /**
+     * @brief Engine that walks the combinations depth-first, carrying the matching set of the
+     * prefix {j1 ... j(k-1)} down to {j1 ... jk}. Since adding a feature can only shrink the
+     * matching set, a branch whose set is exactly {u} is pruned: the risk of u is 1 for that
+     * size and every larger one. A single walk computes every size in [h_min, h_max].
+     * Membership of a candidate is tested on the per-feature match bitsets of the user.
+     */
+    class AprioriEngine: public Engine {
+    private:
+        /**
+         * @brief State of the search for a single user.
+         */
+        struct Search {
+            // Index of the user's record
+            size_t i;
+            // True if the user matches itself on every feature
+            bool self_match;
+            // Smallest background knowledge size of the search
+            short h_lo;
+            // Largest background knowledge size of the search
+            short h;
+            // Per-feature match bitsets of the user
+            std::vector<bitset_word> bits;
+            // Number of words in a bitset
+            size_t words;
+            // Matching set of each prefix length
+            std::vector<std::vector<size_t>> sets;
+            // Minimum number of matches for each combination size
+            std::vector<int> min_matches;
+            // True if a combination of that size has a single match
+            std::vector<bool> single;
+            // Number of sizes in [h_lo, h] that are not yet known to have risk 1
+            short open;
+        };
+
+        /**
+         * @brief Checks if the user matches v on a single feature.
+         */
+        bool matches_feature(const Search& search, const size_t& v, const size_t& j) const {
+            return (search.bits[j * search.words + v / BITSET_WORD_BITS] >> (v % BITSET_WORD_BITS)) & 1;
+        }
+
+        /**
+         * @brief Marks a combination size as having risk 1.
+         */
+        void set_single(Search& search, const size_t& size) const {
+            if (!search.single[size]) {
+                search.single[size] = true;
+                if (size >= (size_t) search.h_lo)
+                    search.open--;
+            }
+        }
+
+        /**
+         * @brief Checks if some size in (size, reachable] can still change.
+         */
+        bool deeper_open(const Search& search, const size_t& size, const size_t& reachable) const {
+            for (size_t s = std::max(size + 1, (size_t) search.h_lo); s <= reachable; s++)
+                if (!search.single[s])
+                    return true;
+            return false;
+        }
+
+        /**
+         * @brief Extends the current prefix with every feature from start on.
+         * 
+         * @param search State of the search.
+         * @param depth Length of the current prefix.
+         * @param start First feature that can extend the prefix.
+         * @return true If every size is known to have risk 1, so the search can stop.
+         * @return false Otherwise.
+         */
+        bool extend(Search& search, const size_t& depth, const size_t& start) const {
+            size_t m = dataset[search.i].features.size();
+            // Size of the combinations built at this depth
+            size_t size = depth + 1;
+            std::vector<size_t>& set = search.sets[depth];
+            // Features left after j must be enough to reach h_lo
+            size_t needed = (size < (size_t) search.h_lo) ? search.h_lo - size : 0;
+            for (size_t j = start; j + needed < m; j++) {
+                // Largest size of the combinations that extend this one
+                size_t reachable = std::min((size_t) search.h, size + (m - 1 - j));
+                // Filters the matching set of the prefix on feature j
+                set.clear();
+                if (depth == 0) {
+                    // Reads the set bits of the feature
+                    for (size_t w = 0; w < search.words; w++)
+                        for (bitset_word word = search.bits[j * search.words + w]; word; word &= word - 1)
+                            set.push_back(w * BITSET_WORD_BITS + __builtin_ctzll(word));
+                }
+                else {
+                    for (size_t v: search.sets[depth - 1])
+                        if (matches_feature(search, v, j))
+                            set.push_back(v);
+                }
+                int matches = 0;
+                if (weights.empty())
+                    matches = set.size();
+                else
+                    for (size_t v: set)
+                        matches += weights[v];
+                if (matches == 1)
+                    set_single(search, size);
+                else
+                    search.min_matches[size] = std::min(search.min_matches[size], matches);
+                if (search.open == 0)
+                    return true;
+                if (size == reachable)
+                    continue;
+                // Only u is left, so every extension has the same matches
+                if (set.size() == 1 && set[0] == search.i && search.self_match) {
+                    for (size_t s = size + 1; s <= reachable; s++)
+                        if (matches == 1)
+                            set_single(search, s);
+                        else
+                            search.min_matches[s] = std::min(search.min_matches[s], matches);
+                    if (search.open == 0)
+                        return true;
+                }
+                // Nobody is left, so every extension has no matches
+                else if (matches == 0) {
+                    for (size_t s = size + 1; s <= reachable; s++)
+                        search.min_matches[s] = 0;
+                }
+                // Extends only if some larger size can still change
+                else if (deeper_open(search, size, reachable) && extend(search, depth + 1, j + 1))
+                    return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Runs the search for the sizes in [h_lo, h].
+         * 
+         * @param i Index of the user's record.
+         * @param h_lo Smallest background knowledge size.
+         * @param h Largest background knowledge size.
+         * @param risks Pointer to the risk values for the sizes in [h_lo, h].
+         */
+        void search(const size_t& i, const short& h_lo, const short& h, float* risks) const {
+            // A size larger than the features selects all of them, like CombinationsEnumerator
+            short m = dataset[i].features.size();
+            short lo = std::min(h_lo, m), hi = std::min(h, m);
+            Search search = {
+                i,
+                self_match(i),
+                lo,
+                hi,
+                {},
+                0,
+                std::vector<std::vector<size_t>>(hi),
+                std::vector<int>(hi + 1, INT_MAX),
+                std::vector<bool>(hi + 1, false),
+                (short) (hi - lo + 1)
+            };
+            search.words = build_match_bitsets(dataset[i], dataset, eps, search.bits);
+            extend(search, 0, 0);
+            for (short s = h_lo; s <= h; s++) {
+                short k = std::min(s, m);
+                // Risk is the inverse of the minimum number of matches
+                risks[s - h_lo] = search.single[k] ? 1.0 : 1.0 / search.min_matches[k];
+            }
+        }
+    public:
+        using Engine::Engine;
+
+        float assess_risk(size_t i, short h) const override {
+            float risk;
+            search(i, h, h, &risk);
+            return risk;
+        }
+
+        void assess_risks(size_t i, float* risks) const override {
+            search(i, h_min, h_max, risks);
+        }
+    };
+} // namespace prudence
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <prudence/record.hpp>
+
+namespace prudence {
+    /**
+     * Binary columnar dataset format, all integers and floats little-endian:
+     *
+     *   magic "PRUDBIN\0" | uint32 version | uint32 reserved | uint64 n | uint64 m
+     *   m feature names, each as uint32 length + bytes
+     *   zero padding up to a multiple of 64 bytes
+     *   m float columns of n values each
+     *   n + 1 uint64 offsets into the ID table, then the ID bytes
+     */
+
+    // Magic bytes at the beginning of a binary dataset
+    constexpr char BINARY_MAGIC[8] = { 'P', 'R', 'U', 'D', 'B', 'I', 'N', '\0' };
+    // Current version of the binary format
+    constexpr uint32_t BINARY_VERSION = 1;
+    // Alignment of the float columns in the file
+    constexpr size_t BINARY_ALIGNMENT = 64;
+
+    /**
+     * @brief Reads a little-endian unsigned integer.
+     */
+    template <typename T>
+    inline T read_le(const char* data) {
+        T value = 0;
+        for (size_t b = 0; b < sizeof(T); b++)
+            value |= T(static_cast<unsigned char>(data[b])) << (8 * b);
+        return value;
+    }
+
+    /**
+     * @brief Writes a little-endian unsigned integer.
+     */
+    template <typename T>
+    inline void write_le(std::ostream& output_stream, const T& value) {
+        char bytes[sizeof(T)];
+        for (size_t b = 0; b < sizeof(T); b++)
+            bytes[b] = static_cast<char>((value >> (8 * b)) & 0xFF);
+        output_stream.write(bytes, sizeof(T));
+    }
+
+    /**
+     * @brief Checks if a buffer starts with the magic bytes of a binary dataset.
+     */
+    inline bool is_binary_dataset(const char* data, const size_t& size) {
+        return size >= sizeof(BINARY_MAGIC) && std::memcmp(data, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0;
+    }
+
+    /**
+     * @brief Reads a binary dataset from memory (typically a mapped file).
+     * The columns are transposed into records, so the mapping can be released afterwards.
+     * 
+     * @param data Beginning of the file.
+     * @param size Size of the file in bytes.
+     * @param dataset Vector of records to fill.
+     * @param feature_names If not null, filled with the names of the features.
+     * @return true If the content is a valid binary dataset.
+     * @return false If it is truncated or has an unsupported version.
+     */
+    inline bool parse_binary_dataset(
+        const char* data,
+        const size_t& size,
+        std::vector<Record>& dataset,
+        std::vector<std::string>* feature_names = nullptr
+    ) {
+        size_t offset = sizeof(BINARY_MAGIC);
+        if (!is_binary_dataset(data, size) || size < offset + 24 || read_le<uint32_t>(data + offset) != BINARY_VERSION)
+            return false;
+        uint64_t n = read_le<uint64_t>(data + offset + 8);
+        uint64_t m = read_le<uint64_t>(data + offset + 16);
+        offset += 24;
+        // Feature names
+        std::vector<std::string> names;
+        for (uint64_t j = 0; j < m; j++) {
+            if (offset + 4 > size)
+                return false;
+            uint32_t length = read_le<uint32_t>(data + offset);
+            offset += 4;
+            if (offset + length > size)
+                return false;
+            names.emplace_back(data + offset, length);
+            offset += length;
+        }
+        offset = (offset + BINARY_ALIGNMENT - 1) / BINARY_ALIGNMENT * BINARY_ALIGNMENT;
+        // Bounds the sizes by the remaining bytes before multiplying them
+        if (offset > size)
+            return false;
+        size_t space = size - offset;
+        if (m > space / sizeof(float) || space < sizeof(uint64_t))
+            return false;
+        size_t row = m * sizeof(float) + sizeof(uint64_t);
+        if (n > (space - sizeof(uint64_t)) / row)
+            return false;
+        // Columns and offsets of the ID table
+        size_t columns = offset;
+        size_t ids = columns + n * m * sizeof(float);
+        size_t id_bytes = ids + (n + 1) * sizeof(uint64_t);
+        uint64_t last = read_le<uint64_t>(data + ids + n * sizeof(uint64_t));
+        if (last > size - id_bytes)
+            return false;
+        // Transposes the columns into records
+        dataset.assign(n, Record());
+        for (uint64_t v = 0; v < n; v++) {
+            Record& record = dataset[v];
+            uint64_t begin = read_le<uint64_t>(data + ids + v * sizeof(uint64_t));
+            uint64_t end = read_le<uint64_t>(data + ids + (v + 1) * sizeof(uint64_t));
+            // Offsets must be non-decreasing and lie before the last one
+            if (begin > end || end > last) {
+                dataset.clear();
+                return false;
+            }
+            record.id.assign(data + id_bytes + begin, end - begin);
+            record.features.resize(m);
+        }
+        for (uint64_t j = 0; j < m; j++) {
+            const char* column = data + columns + j * n * sizeof(float);
+            for (uint64_t v = 0; v < n; v++) {
+                uint32_t bits = read_le<uint32_t>(column + v * sizeof(float));
+                std::memcpy(&dataset[v].features[j], &bits, sizeof(float));
+            }
+        }
+        if (feature_names)
+            *feature_names = std::move(names);
+        return true;
+    }
+
+    /**
+     * @brief Writes a dataset in the binary columnar format to a stream.
+     * 
+     * @param output_stream Binary stream to write.
+     * @param dataset Dataset to write.
+     * @param feature_names Names of the features.
+     * @return true If the dataset has been written.
+     * @return false If the stream failed.
+     */
+    inline bool write_binary_dataset(
+        std::ostream& output_stream,
+        const std::vector<Record>& dataset,
+        const std::vector<std::string>& feature_names
+    ) {
+        uint64_t n = dataset.size();
+        uint64_t m = feature_names.size();
+        // Header
+        output_stream.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+        write_le<uint32_t>(output_stream, BINARY_VERSION);
+        write_le<uint32_t>(output_stream, 0);
+        write_le<uint64_t>(output_stream, n);
+        write_le<uint64_t>(output_stream, m);
+        size_t offset = sizeof(BINARY_MAGIC) + 24;
+        for (const std::string& name: feature_names) {
+            write_le<uint32_t>(output_stream, name.size());
+            output_stream.write(name.data(), name.size());
+            offset += 4 + name.size();
+        }
+        // Padding before the columns
+        while (offset % BINARY_ALIGNMENT != 0) {
+            output_stream.put('\0');
+            offset++;
+        }
+        // Columns
+        std::vector<char> column(n * sizeof(float));
+        for (uint64_t j = 0; j < m; j++) {
+            for (uint64_t v = 0; v < n; v++) {
+                float value = j < dataset[v].features.size() ? dataset[v].features[j] : 0;
+                uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(float));
+                for (size_t b = 0; b < sizeof(float); b++)
+                    column[v * sizeof(float) + b] = static_cast<char>((bits >> (8 * b)) & 0xFF);
+            }
+            output_stream.write(column.data(), column.size());
+        }
+        // ID table
+        uint64_t id_offset = 0;
+        write_le<uint64_t>(output_stream, id_offset);
+        for (const Record& record: dataset) {
+            id_offset += record.id.size();
+            write_le<uint64_t>(output_stream, id_offset);
+        }
+        for (const Record& record: dataset)
+            output_stream.write(record.id.data(), record.id.size());
+        return output_stream.good();
+    }
+
+    /**
+     * @brief Writes a dataset in the binary columnar format.
+     * 
+     * @param path Path of the output file.
+     * @param dataset Dataset to write.
+     * @param feature_names Names of the features.
+     * @return true If the file has been written.
+     * @return false If the file could not be written.
+     */
+    inline bool write_binary_dataset(
+        const std::string& path,
+        const std::vector<Record>& dataset,
+        const std::vector<std::string>& feature_names
+    ) {
+        std::ofstream output_stream(path, std::ios::binary);
+        if (!output_stream.is_open())
+            return false;
+        return write_binary_dataset(output_stream, dataset, feature_names);
+    }
+} // namespace prudence
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+#include <prudence/engine.hpp>
+
+namespace prudence {
+    // Word of a match bitset
+    using bitset_word = uint64_t;
+    // Number of bits in a word of a match bitset
+    constexpr size_t BITSET_WORD_BITS = 64;
+
+    /**
+     * @brief Builds the match bitset of every feature for a user: the bit v of the bitset
+     * of feature j is set if u matches v on j.
+     * 
+     * @param u User's record.
+     * @param dataset Global view of the dataset.
+     * @param eps Epsilon margin for the matching.
+     * @param bits Bitsets to fill, one after the other.
+     * @return size_t Number of words in a bitset.
+     */
+    inline size_t build_match_bitsets(
+        const Record& u,
+        const std::vector<Record>& dataset,
+        const float& eps,
+        std::vector<bitset_word>& bits
+    ) {
+        size_t m = u.features.size();
+        size_t words = (dataset.size() + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+        bits.assign(m * words, 0);
+        for (size_t v = 0; v < dataset.size(); v++) {
+            const std::vector<float>& features = dataset[v].features;
+            for (size_t j = 0; j < m; j++) {
+                // Same bounds as Record::matches
+                float lo = features[j] - features[j] * eps;
+                float hi = features[j] + features[j] * eps;
+                if (!(u.features[j] < lo || u.features[j] > hi))
+                    bits[j * words + v / BITSET_WORD_BITS] |= bitset_word(1) << (v % BITSET_WORD_BITS);
+            }
+        }
+        return words;
+    }
+
+    /**
+     * @brief Engine that computes the risk by intersecting per-feature match bitsets.
+     * For a user u, the bit v of the bitset of feature j is set if u matches v on j,
+     * so |R_t| for a combination is the popcount of the AND of its h bitsets.
+     */
+    class BitsetEngine: public Engine {
+    private:
+        using word_t = bitset_word;
+        // Number of words in a bitset
+        size_t words;
+        // Bitset of the records that stand for more than one original record
+        std::vector<word_t> heavy;
+
+        /**
+         * @brief Computes the risk of a user from its bitsets.
+         * 
+         * @param bits Bitsets of the features of the user.
+         * @param m Number of features.
+         * @param h Background knowledge size.
+         * @return float Risk for the user.
+         */
+        float risk_from_bitsets(const std::vector<word_t>& bits, const size_t& m, const short& h) const {
+            // Indices of the features in the current combination
+            std::vector<size_t> selected(h);
+            // Minimum number of matches for a combination
+            int min_matches = INT_MAX;
+            CombinationsEnumerator comb(m, h);
+            do {
+                for (size_t j = 0, k = 0; j < comb.mask.size(); j++)
+                    if (comb.mask[j])
+                        selected[k++] = j;
+                // Number of matches for the combination
+                int matches = 0;
+                for (size_t w = 0; w < words; w++) {
+                    word_t word = ~word_t(0);
+                    for (size_t j: selected)
+                        word &= bits[j * words + w];
+                    matches += __builtin_popcountll(word & ~heavy[w]);
+                    // Heavy records count as many times as their weight
+                    for (word &= heavy[w]; word; word &= word - 1)
+                        matches += weights[w * BITSET_WORD_BITS + __builtin_ctzll(word)];
+                }
+                // If we have only 1 match the combination gives the risk
+                if (matches == 1)
+                    return 1.0;
+                // Else we take the minimum number of matches found
+                if (matches < min_matches)
+                    min_matches = matches;
+            } while (comb.next());
+            // Risk is the inverse of the minimum number of matches
+            return 1.0 / min_matches;
+        }
+    public:
+        /**
+         * @brief Construct a new bitset engine object.
+         * 
+         * @param _dataset Global view of the dataset.
+         * @param _h_min Smallest background knowledge size.
+         * @param _h_max Largest background knowledge size.
+         * @param _eps Epsilon margin for the matching.
+         * @param _weights Number of original records represented by each record, empty if all are 1.
+         */
+        BitsetEngine(
+            std::vector<Record>& _dataset,
+            const short& _h_min,
+            const short& _h_max,
+            const float& _eps,
+            const std::vector<int>& _weights = {}
+        ):
+            Engine(_dataset, _h_min, _h_max, _eps, _weights),
+            words((_dataset.size() + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS),
+            heavy(words, 0) {
+            for (size_t v = 0; v < weights.size(); v++)
+                if (weights[v] != 1)
+                    heavy[v / BITSET_WORD_BITS] |= word_t(1) << (v % BITSET_WORD_BITS);
+        }
+
+        float assess_risk(size_t i, short h) const override {
+            const Record& u = dataset[i];
+            // Bitsets of the features, stored contiguously
+            std::vector<word_t> bits;
+            build_match_bitsets(u, dataset, eps, bits);
+            return risk_from_bitsets(bits, u.features.size(), h);
+        }
+
+        /**
+         * @brief Builds the bitsets once and reuses them for every background knowledge size.
+         */
+        void assess_risks(size_t i, float* risks) const override {
+            const Record& u = dataset[i];
+            std::vector<word_t> bits;
+            build_match_bitsets(u, dataset, eps, bits);
+            bool monotone = (h_min != h_max) && self_match(i);
+            for (short h = h_min; h <= h_max; h++) {
+                size_t l = h - h_min;
+                risks[l] = (l > 0 && monotone && risks[l - 1] == 1.0) ? 1.0 : risk_from_bitsets(bits, u.features.size(), h);
+            }
+        }
+    };
+} // namespace prudence
@@ -0,0 +1,399 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <prudence/binary.hpp>
+#include <prudence/engine.hpp>
+#include <prudence/options.hpp>
+
+namespace prudence {
+    /**
+     * Checkpoint file, written next to the output, all integers little-endian:
+     *
+     *   magic "PRUDCKP\0" | uint32 version | uint32 reserved | uint64 fingerprint
+     *   uint64 n | uint64 width | uint64 number of ranges
+     *   for each range of finished users: uint64 begin | uint64 end | (end - begin) * width float bits
+     */
+
+    // Magic bytes at the beginning of a checkpoint file
+    constexpr char CHECKPOINT_MAGIC[8] = { 'P', 'R', 'U', 'D', 'C', 'K', 'P', '\0' };
+    // Current version of the checkpoint file
+    constexpr uint32_t CHECKPOINT_VERSION = 1;
+
+    class Checkpoint;
+
+    /**
+     * @brief Engine that records the users computed by another engine in a checkpoint. Ranges
+     * are computed in pieces, so that a single large range (as in the sequential algorithm) is
+     * recorded as it progresses, and the users already finished are skipped.
+     */
+    class CheckpointedEngine: public Engine {
+    private:
+        // Engine that computes the risks
+        std::unique_ptr<Engine> engine;
+        // Checkpoint that records the finished users
+        Checkpoint& checkpoint;
+    public:
+        // Largest number of users computed between two records
+        static constexpr size_t PIECE = 64;
+
+        /**
+         * @brief Construct a new checkpointed engine object.
+         *
+         * @param _dataset Global view of the dataset.
+         * @param options Command line options.
+         * @param _engine Engine that computes the risks.
+         * @param _checkpoint Checkpoint that records the finished users.
+         */
+        CheckpointedEngine(
+            std::vector<Record>& _dataset,
+            const Options& options,
+            std::unique_ptr<Engine>&& _engine,
+            Checkpoint& _checkpoint
+        ): Engine(_dataset, options.h_min, options.h, options.eps), engine(std::move(_engine)), checkpoint(_checkpoint) {}
+
+        size_t width() const override {
+            return engine->width();
+        }
+
+        std::vector<std::string> columns() const override {
+            return engine->columns();
+        }
+
+        float assess_risk(size_t i, short h) const override {
+            return engine->assess_risk(i, h);
+        }
+
+        void assess_risks(size_t i, float* risks) const override {
+            engine->assess_risks(i, risks);
+        }
+
+        void assess_range(size_t begin, size_t end, float* risks) const override;
+
+        std::string report() const override;
+    };
+
+    /**
+     * @brief Periodic checkpoint of the finished users and of their risks. The file is written
+     * to a temporary path, synced and renamed over the previous one, so a crash leaves either
+     * the old or the new checkpoint. On resume the risks of the finished users are restored,
+     * and the schedulers hand out only the unfinished users: they work on positions in the
+     * unfinished users, mapped back to indices by index(), so that a range of positions is a
+     * range of indices whose finished users are skipped.
+     */
+    class Checkpoint {
+    private:
+        // Path of the checkpoint file
+        std::string path;
+        // Hash of the records and of the options that change the risks
+        uint64_t fingerprint;
+        // Matrix of risk values, one row per user
+        std::vector<float>& risks;
+        // Number of risk values of each user
+        size_t width;
+        // Seconds between two checkpoints, 0 if disabled
+        double interval;
+        // True if the computation continues from the checkpoint
+        bool resume;
+        // 1 for the finished users
+        std::vector<uint8_t> done;
+        // Indices of the users not finished when the computation started
+        std::vector<size_t> unfinished_users;
+        // Guards the flags and the file
+        std::mutex mutex;
+        // Time of the start of the computation and of the last checkpoint
+        std::chrono::steady_clock::time_point start, last;
+        // Number of checkpoints written and time spent writing them, in seconds
+        size_t saves = 0;
+        double save_time = 0;
+
+        /**
+         * @brief FNV-1a hash of some bytes, chained from a previous hash.
+         */
+        static uint64_t hash(const void* data, const size_t& size, uint64_t value = 0xCBF29CE484222325ULL) {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            for (size_t b = 0; b < size; b++) {
+                value ^= bytes[b];
+                value *= 0x100000001B3ULL;
+            }
+            return value;
+        }
+
+        /**
+         * @brief Writes the finished users, the mutex being held.
+         */
+        bool save_locked() {
+            auto begin = std::chrono::steady_clock::now();
+            size_t n = done.size();
+            // Ranges of finished users
+            std::vector<std::pair<size_t, size_t>> ranges;
+            for (size_t i = 0; i < n; i++)
+                if (done[i]) {
+                    if (ranges.empty() || ranges.back().second != i)
+                        ranges.push_back({ i, i });
+                    ranges.back().second++;
+                }
+            std::ostringstream stream(std::ios::binary);
+            stream.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+            write_le<uint32_t>(stream, CHECKPOINT_VERSION);
+            write_le<uint32_t>(stream, 0);
+            write_le<uint64_t>(stream, fingerprint);
+            write_le<uint64_t>(stream, n);
+            write_le<uint64_t>(stream, width);
+            write_le<uint64_t>(stream, ranges.size());
+            for (const std::pair<size_t, size_t>& range: ranges) {
+                write_le<uint64_t>(stream, range.first);
+                write_le<uint64_t>(stream, range.second);
+                for (size_t k = range.first * width; k < range.second * width; k++) {
+                    uint32_t bits;
+                    std::memcpy(&bits, &risks[k], sizeof(float));
+                    write_le<uint32_t>(stream, bits);
+                }
+            }
+            // Written aside and renamed, so that the previous checkpoint survives a crash
+            std::string content = stream.str();
+            std::string temporary = path + ".tmp";
+            int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+                return false;
+            bool written = true;
+            for (size_t offset = 0; written && offset < content.size();) {
+                ssize_t count = ::write(fd, content.data() + offset, content.size() - offset);
+                written = count > 0;
+                offset += written ? count : 0;
+            }
+            written = written && ::fsync(fd) == 0;
+            ::close(fd);
+            if (!written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+                std::remove(temporary.c_str());
+                return false;
+            }
+            auto now = std::chrono::steady_clock::now();
+            save_time += std::chrono::duration<double>(now - begin).count();
+            saves++;
+            last = now;
+            return true;
+        }
+    public:
+        // Seconds between two checkpoints when only --resume is given
+        static constexpr double DEFAULT_INTERVAL = 60;
+
+        /**
+         * @brief Construct a new checkpoint object, with the file next to the output.
+         *
+         * @param options Command line options.
+         * @param records Records on which the risk is computed, in the order of the engine.
+         * @param _risks Matrix of risk values, one row per user.
+         * @param _width Number of risk values of each user.
+         */
+        Checkpoint(
+            const Options& options,
+            const std::vector<Record>& records,
+            std::vector<float>& _risks,
+            const size_t& _width
+        ):
+            path(options.output + ".checkpoint"),
+            risks(_risks),
+            width(_width),
+            interval(options.checkpoint > 0 ? options.checkpoint : options.resume ? DEFAULT_INTERVAL : 0),
+            resume(options.resume),
+            done(records.size(), 0),
+            unfinished_users(records.size()) {
+            // Only the options that change the risks or the order of the users, floats in hex so that they are exact
+            std::ostringstream stream;
+            stream << std::hexfloat << options.h_min << ":" << options.h << " " << options.dedup << " " << options.schedule << " "
+                   << options.engine << " " << options.bits << " " << options.threshold << " " << options.top << " "
+                   << options.sample << " " << options.stratified << " " << options.sample_combinations << " "
+                   << options.seed << " " << width;
+            for (const float& eps: options.eps_values)
+                stream << " " << eps;
+            std::string text = stream.str();
+            fingerprint = hash(text.data(), text.size());
+            // IDs and feature values of the records, in the order of the engine
+            for (const Record& record: records) {
+                fingerprint = hash(record.id.c_str(), record.id.size() + 1, fingerprint);
+                fingerprint = hash(record.features.data(), record.features.size() * sizeof(float), fingerprint);
+            }
+            for (size_t i = 0; i < records.size(); i++)
+                unfinished_users[i] = i;
+            start = last = std::chrono::steady_clock::now();
+        }
+
+        /**
+         * @brief True if the finished users are recorded.
+         */
+        bool enabled() const {
+            return interval > 0;
+        }
+
+        /**
+         * @brief In resume mode, restores the risks of the users finished in the checkpoint.
+         * A missing checkpoint starts from scratch.
+         *
+         * @return true If the computation can start.
+         * @return false If the checkpoint is invalid or belongs to another computation.
+         */
+        bool restore() {
+            if (!resume)
+                return true;
+            std::ifstream input_stream(path, std::ios::binary);
+            if (!input_stream.is_open())
+                return true;
+            std::string content((std::istreambuf_iterator<char>(input_stream)), std::istreambuf_iterator<char>());
+            const char* data = content.data();
+            size_t offset = sizeof(CHECKPOINT_MAGIC) + 40;
+            if (content.size() < offset || std::memcmp(data, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0
+                || read_le<uint32_t>(data + 8) != CHECKPOINT_VERSION) {
+                std::cerr << path << " is not a valid checkpoint" << std::endl;
+                return false;
+            }
+            if (read_le<uint64_t>(data + 16) != fingerprint || read_le<uint64_t>(data + 24) != done.size()
+                || read_le<uint64_t>(data + 32) != width) {
+                std::cerr << path << " belongs to another dataset or other options" << std::endl;
+                return false;
+            }
+            uint64_t ranges = read_le<uint64_t>(data + 40);
+            for (uint64_t r = 0; r < ranges; r++) {
+                uint64_t begin = content.size() < offset + 16 ? 1 : read_le<uint64_t>(data + offset);
+                uint64_t end = content.size() < offset + 16 ? 0 : read_le<uint64_t>(data + offset + 8);
+                offset += 16;
+                if (begin > end || end > done.size() || content.size() < offset + (end - begin) * width * 4) {
+                    std::cerr << path << " is truncated" << std::endl;
+                    return false;
+                }
+                for (size_t k = begin * width; k < end * width; k++, offset += 4) {
+                    uint32_t bits = read_le<uint32_t>(data + offset);
+                    std::memcpy(&risks[k], &bits, sizeof(float));
+                }
+                std::fill(done.begin() + begin, done.begin() + end, 1);
+            }
+            unfinished_users.clear();
+            for (size_t i = 0; i < done.size(); i++)
+                if (!done[i])
+                    unfinished_users.push_back(i);
+            return true;
+        }
+
+        /**
+         * @brief Wraps an engine so that it records the finished users, if enabled.
+         *
+         * @param dataset Records on which the risk is computed.
+         * @param options Command line options.
+         * @param engine Engine that computes the risks.
+         * @return std::unique_ptr<Engine> The engine to use.
+         */
+        std::unique_ptr<Engine> track(std::vector<Record>& dataset, const Options& options, std::unique_ptr<Engine>&& engine) {
+            start = last = std::chrono::steady_clock::now();
+            if (!enabled())
+                return std::move(engine);
+            return std::make_unique<CheckpointedEngine>(dataset, options, std::move(engine), *this);
+        }
+
+        /**
+         * @brief Number of users not finished when the computation started.
+         */
+        size_t unfinished() const {
+            return unfinished_users.size();
+        }
+
+        /**
+         * @brief Index of the user at a position in the unfinished users, the number of
+         * users for the position after the last one.
+         */
+        size_t index(const size_t& position) const {
+            return position < unfinished_users.size() ? unfinished_users[position] : done.size();
+        }
+
+        /**
+         * @brief Splits the unfinished users into shards of about equal size, each cut into
+         * runs of consecutive indices.
+         *
+         * @param shards Number of shards.
+         * @return std::vector<std::pair<size_t, size_t>> Ranges of unfinished users.
+         */
+        std::vector<std::pair<size_t, size_t>> runs(const size_t& shards) const {
+            std::vector<std::pair<size_t, size_t>> ranges;
+            size_t p = unfinished_users.size();
+            for (size_t s = 0; s < shards; s++)
+                for (size_t k = p * s / shards; k < p * (s + 1) / shards; k++) {
+                    if (k == p * s / shards || ranges.back().second != unfinished_users[k])
+                        ranges.push_back({ unfinished_users[k], unfinished_users[k] });
+                    ranges.back().second++;
+                }
+            return ranges;
+        }
+
+        /**
+         * @brief True if the risks of a user are already computed. Only the flags of the users
+         * of a range owned by the caller are read, so no lock is needed.
+         */
+        bool finished(const size_t& i) const {
+            return done[i];
+        }
+
+        /**
+         * @brief Records a range of finished users, writing a checkpoint if the interval has passed.
+         */
+        void complete(const size_t& begin, const size_t& end) {
+            std::unique_lock<std::mutex> lock(mutex);
+            std::fill(done.begin() + begin, done.begin() + end, 1);
+            if (std::chrono::steady_clock::now() - last >= std::chrono::duration<double>(interval) && !save_locked())
+                std::cerr << "Unable to write checkpoint " << path << std::endl;
+        }
+
+        /**
+         * @brief Removes the checkpoint once the output is written.
+         */
+        void finish() {
+            std::remove(path.c_str());
+        }
+
+        /**
+         * @brief Checkpoints written and the fraction of the computation spent writing them.
+         */
+        std::string report() {
+            std::unique_lock<std::mutex> lock(mutex);
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::ostringstream stream;
+            stream << " Checkpoints: " << saves << " Overhead: " << (elapsed > 0 ? 100.0 * save_time / elapsed : 0.0) << "%";
+            if (resume)
+                stream << " Resumed: " << done.size() - unfinished_users.size() << "/" << done.size();
+            return stream.str();
+        }
+    };
+
+    inline void CheckpointedEngine::assess_range(size_t begin, size_t end, float* risks) const {
+        size_t width = this->width();
+        for (size_t i = begin; i < end;) {
+            // Skips the finished users
+            if (checkpoint.finished(i)) {
+                i++;
+                continue;
+            }
+            size_t e = i + 1;
+            while (e < end && e - i < PIECE && !checkpoint.finished(e))
+                e++;
+            engine->assess_range(i, e, risks + (i - begin) * width);
+            checkpoint.complete(i, e);
+            i = e;
+        }
+    }
+
+    inline std::string CheckpointedEngine::report() const {
+        return engine->report() + checkpoint.report();
+    }
+} // namespace prudence
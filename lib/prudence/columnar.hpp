@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <prudence/record.hpp>
+
+namespace prudence {
+    /**
+     * @brief Dataset stored by columns: one contiguous, 64-byte aligned float array per feature,
+     * with the IDs stored separately.
+     */
+    class ColumnarDataset {
+    private:
+        // Deleter for memory obtained with std::aligned_alloc
+        struct Free {
+            void operator()(float* data) const { std::free(data); }
+        };
+        // Number of records
+        size_t n;
+        // Number of features
+        size_t m;
+        // Distance between two columns, n rounded up to a whole cache line
+        size_t stride;
+        // Columns, one after the other
+        std::unique_ptr<float[], Free> data;
+    public:
+        // Alignment of every column
+        static constexpr size_t ALIGNMENT = 64;
+        // IDs of the records
+        std::vector<std::string> ids;
+
+        /**
+         * @brief Construct a new columnar dataset object from a dataset of records.
+         * 
+         * @param dataset Dataset of records.
+         */
+        ColumnarDataset(const std::vector<Record>& dataset):
+            n(dataset.size()),
+            m(dataset.empty() ? 0 : dataset[0].features.size()),
+            stride((n + ALIGNMENT / sizeof(float) - 1) / (ALIGNMENT / sizeof(float)) * (ALIGNMENT / sizeof(float))),
+            data(static_cast<float*>(std::aligned_alloc(ALIGNMENT, std::max<size_t>(m * stride, 1) * sizeof(float)))) {
+            if (!data)
+                throw std::bad_alloc();
+            ids.reserve(n);
+            for (size_t v = 0; v < n; v++) {
+                ids.push_back(dataset[v].id);
+                for (size_t j = 0; j < m; j++)
+                    data[j * stride + v] = dataset[v].features[j];
+            }
+            // Zeroes the padding at the end of the columns
+            for (size_t j = 0; j < m; j++)
+                for (size_t v = n; v < stride; v++)
+                    data[j * stride + v] = 0;
+        }
+
+        /**
+         * @brief Construct an empty columnar dataset with room for a block of records, to be
+         * filled column by column. The memory is left untouched until it is filled.
+         * 
+         * @param capacity Maximum number of records.
+         * @param features Number of features.
+         */
+        ColumnarDataset(const size_t& capacity, const size_t& features):
+            n(0),
+            m(features),
+            stride((capacity + ALIGNMENT / sizeof(float) - 1) / (ALIGNMENT / sizeof(float)) * (ALIGNMENT / sizeof(float))),
+            data(static_cast<float*>(std::aligned_alloc(ALIGNMENT, std::max<size_t>(m * stride, 1) * sizeof(float)))) {
+            if (!data)
+                throw std::bad_alloc();
+        }
+
+        /**
+         * @brief Sets the number of records of a block, at most its capacity.
+         */
+        void resize(const size_t& count) {
+            n = std::min(count, stride);
+        }
+
+        /**
+         * @brief Maximum number of records.
+         */
+        size_t capacity() const {
+            return stride;
+        }
+
+        /**
+         * @brief Number of records.
+         */
+        size_t size() const {
+            return n;
+        }
+
+        /**
+         * @brief Number of features.
+         */
+        size_t features() const {
+            return m;
+        }
+
+        /**
+         * @brief Column of a feature.
+         * 
+         * @param j Index of the feature.
+         * @return const float* Aligned pointer to the n values of the feature.
+         */
+        const float* column(const size_t& j) const {
+            return data.get() + j * stride;
+        }
+
+        /**
+         * @brief Column of a feature, to be filled.
+         */
+        float* column(const size_t& j) {
+            return data.get() + j * stride;
+        }
+
+        /**
+         * @brief Value of a feature of a record.
+         */
+        float at(const size_t& v, const size_t& j) const {
+            return data[j * stride + v];
+        }
+    };
+} // namespace prudence
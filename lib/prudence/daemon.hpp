@@ -0,0 +1,477 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <prudence/columnar.hpp>
+#include <prudence/distributed.hpp>
+#include <prudence/pool.hpp>
+#include <prudence/simd.hpp>
+
+#include <safe_queue.hpp>
+
+namespace prudence {
+    /**
+     * Line protocol of the daemon, one request per line and one reply per request, in order.
+     * h and eps can be "-" for the defaults of the daemon; an ID starting with '#' is the
+     * index of the user in the dataset.
+     *
+     *   INFO                    -> OK users features h eps
+     *   RECORD id               -> OK f1,f2,...,fm
+     *   RISK h eps id           -> OK risk
+     *   BATCH h eps id1 id2 ... -> OK risk1 risk2 ...
+     *   WHATIF h eps f1,...,fm  -> OK risk of the record if it were added to the dataset
+     *   SHUTDOWN                -> OK, then the daemon stops
+     *
+     * A request that cannot be answered gets "ERR reason".
+     */
+
+    /**
+     * @brief Resident copy of the dataset that answers risk queries for any background knowledge
+     * size and epsilon, with the vector kernels over a columnar layout. The risks of the users
+     * already computed are remembered.
+     */
+    class RiskIndex {
+    private:
+        // Records, for the features of the users and the IDs
+        std::vector<Record> dataset;
+        // Columnar copy scanned by the kernel
+        ColumnarDataset columns;
+        // Kernel that counts the matches
+        match_kernel kernel;
+        // Index of every ID
+        std::unordered_map<std::string, size_t> ids;
+        // Risks already computed, by user, background knowledge size and epsilon
+        std::unordered_map<std::string, float> memo;
+        // Guards the memo
+        mutable std::mutex memo_mutex;
+        // Largest number of remembered risks, the memo is cleared when it is reached
+        static constexpr size_t MEMO_CAPACITY = 1 << 20;
+
+        /**
+         * @brief Key of a risk in the memo.
+         */
+        static std::string memo_key(const size_t& i, const short& h, const float& eps) {
+            uint32_t bits;
+            std::memcpy(&bits, &eps, sizeof(float));
+            return std::to_string(i) + ":" + std::to_string(h) + ":" + std::to_string(bits);
+        }
+    public:
+        /**
+         * @brief Construct a new risk index object.
+         *
+         * @param _dataset Dataset, moved into the index.
+         * @param _kernel Kernel that counts the matches.
+         */
+        RiskIndex(std::vector<Record>&& _dataset, match_kernel _kernel):
+            dataset(std::move(_dataset)), columns(dataset), kernel(_kernel) {
+            for (size_t i = 0; i < dataset.size(); i++)
+                ids.emplace(dataset[i].id, i);
+        }
+
+        /**
+         * @brief Number of users.
+         */
+        size_t size() const {
+            return dataset.size();
+        }
+
+        /**
+         * @brief Number of features.
+         */
+        size_t features() const {
+            return columns.features();
+        }
+
+        /**
+         * @brief Record of a user.
+         */
+        const Record& record(const size_t& i) const {
+            return dataset[i];
+        }
+
+        /**
+         * @brief Finds a user by ID, or by index if the ID starts with '#'.
+         *
+         * @param id ID of the user.
+         * @param i Index of the user.
+         * @return true If the user exists.
+         * @return false Otherwise.
+         */
+        bool find(const std::string& id, size_t& i) const {
+            if (id.size() > 1 && id[0] == '#') {
+                char* end;
+                i = strtoull(id.c_str() + 1, &end, 10);
+                return *end == '\0' && i < dataset.size();
+            }
+            auto found = ids.find(id);
+            if (found == ids.end())
+                return false;
+            i = found->second;
+            return true;
+        }
+
+        /**
+         * @brief Computes the risk of a record against the dataset.
+         *
+         * @param u Values of the features of the record.
+         * @param h Background knowledge size, between 1 and features().
+         * @param eps Epsilon margin for the matching.
+         * @param hypothetical True if the record is not in the dataset, so it has to be counted
+         * as a match of itself.
+         * @return float Risk of the record.
+         */
+        float risk(const float* u, const short& h, const float& eps, const bool& hypothetical) const {
+            // Indices of the features in the current combination
+            std::vector<size_t> selected(h);
+            // Minimum number of matches for a combination
+            int min_matches = INT_MAX;
+            CombinationsEnumerator comb(columns.features(), h);
+            do {
+                for (size_t j = 0, k = 0; j < comb.mask.size(); j++)
+                    if (comb.mask[j])
+                        selected[k++] = j;
+                // Number of matches for the combination
+                int matches = kernel(columns, u, selected.data(), h, eps, nullptr, 0, columns.size());
+                if (hypothetical) {
+                    bool self = true;
+                    for (short k = 0; k < h && self; k++) {
+                        float value = u[selected[k]];
+                        self = !(value < value - value * eps || value > value + value * eps);
+                    }
+                    matches += self;
+                }
+                // If we have only 1 match the combination gives the risk
+                if (matches == 1)
+                    return 1.0;
+                // Else we take the minimum number of matches found
+                if (matches < min_matches)
+                    min_matches = matches;
+            } while (comb.next());
+            // Risk is the inverse of the minimum number of matches
+            return 1.0 / min_matches;
+        }
+
+        /**
+         * @brief Computes the risk of a user, or returns it if it has already been computed.
+         */
+        float risk(const size_t& i, const short& h, const float& eps) {
+            std::string key = memo_key(i, h, eps);
+            {
+                std::unique_lock<std::mutex> lock(memo_mutex);
+                auto found = memo.find(key);
+                if (found != memo.end())
+                    return found->second;
+            }
+            float value = risk(dataset[i].features.data(), h, eps, false);
+            std::unique_lock<std::mutex> lock(memo_mutex);
+            if (memo.size() >= MEMO_CAPACITY)
+                memo.clear();
+            memo.emplace(key, value);
+            return value;
+        }
+    };
+
+    /**
+     * @brief Reads the lines of a connection, keeping the bytes after the last newline.
+     */
+    class LineReader {
+    private:
+        // Descriptor of the connection
+        int fd;
+        // Bytes read and not returned yet
+        std::string buffer;
+    public:
+        LineReader(const int& _fd): fd(_fd) {}
+
+        /**
+         * @brief Reads the next line, without the newline.
+         *
+         * @return true If a line has been read.
+         * @return false If the peer is gone.
+         */
+        bool next(std::string& line) {
+            size_t newline;
+            while ((newline = buffer.find('\n')) == std::string::npos) {
+                char chunk[4096];
+                ssize_t received = read(fd, chunk, sizeof(chunk));
+                if (received < 0 && errno == EINTR)
+                    continue;
+                if (received <= 0)
+                    return false;
+                buffer.append(chunk, received);
+            }
+            line = buffer.substr(0, newline);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            buffer.erase(0, newline + 1);
+            return true;
+        }
+    };
+
+    /**
+     * @brief Server that keeps a risk index resident and answers the requests of the line
+     * protocol on a Unix domain socket. Every connection has a thread that parses its requests;
+     * the risks are computed by a shared pool, with the users of a batch split among its threads.
+     */
+    class Daemon {
+    private:
+        // Resident dataset
+        RiskIndex& index;
+        // Threads computing the risks
+        ComputePool pool;
+        // Default background knowledge size
+        short h;
+        // Default epsilon
+        float eps;
+        // True once the daemon has to stop
+        std::atomic<bool> stopping{ false };
+        // Descriptors of the open connections, to wake them up at shutdown
+        std::vector<int> connections;
+        // Guards the connections
+        std::mutex connections_mutex;
+        // Signaled when a connection is closed
+        std::condition_variable closed;
+
+        /**
+         * @brief Parses the "h eps" fields of a request.
+         *
+         * @return true If both are valid.
+         * @return false Otherwise, after filling the error.
+         */
+        bool parse_parameters(std::istringstream& words, short& query_h, float& query_eps, std::string& error) const {
+            std::string h_word, eps_word;
+            if (!(words >> h_word >> eps_word)) {
+                error = "missing h and eps";
+                return false;
+            }
+            char* end;
+            query_h = (h_word == "-") ? h : (short) strtol(h_word.c_str(), &end, 10);
+            if ((h_word != "-" && *end != '\0') || query_h < 1 || (size_t) query_h > index.features()) {
+                error = "invalid h " + h_word;
+                return false;
+            }
+            query_eps = (eps_word == "-") ? eps : strtof(eps_word.c_str(), &end);
+            if ((eps_word != "-" && *end != '\0') || !(query_eps >= 0)) {
+                error = "invalid eps " + eps_word;
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Answers a request.
+         *
+         * @param line Request.
+         * @return std::string Reply, without the newline.
+         */
+        std::string answer(const std::string& line) {
+            std::istringstream words(line);
+            std::string verb;
+            words >> verb;
+            std::ostringstream reply;
+            std::string error;
+            short query_h;
+            float query_eps;
+            if (verb == "INFO")
+                reply << "OK " << index.size() << " " << index.features() << " " << h << " " << eps;
+            else if (verb == "RECORD") {
+                std::string id;
+                size_t i;
+                if (!(words >> id) || !index.find(id, i))
+                    return "ERR unknown id " + id;
+                // Enough digits to read the same floats back
+                reply.precision(std::numeric_limits<float>::max_digits10);
+                reply << "OK ";
+                const std::vector<float>& features = index.record(i).features;
+                for (size_t j = 0; j < features.size(); j++)
+                    reply << (j ? "," : "") << features[j];
+            }
+            else if (verb == "RISK" || verb == "BATCH") {
+                if (!parse_parameters(words, query_h, query_eps, error))
+                    return "ERR " + error;
+                std::vector<size_t> users;
+                for (std::string id; words >> id;) {
+                    size_t i;
+                    if (!index.find(id, i))
+                        return "ERR unknown id " + id;
+                    users.push_back(i);
+                }
+                if (users.empty() || (verb == "RISK" && users.size() != 1))
+                    return "ERR " + verb + " needs " + (verb == "RISK" ? "one id" : "some ids");
+                // Splits the users among the threads of the pool
+                std::vector<float> risks(users.size());
+                size_t tasks = std::min(users.size(), pool.size());
+                pool.run(tasks, [&](size_t t) {
+                    for (size_t k = users.size() * t / tasks; k < users.size() * (t + 1) / tasks; k++)
+                        risks[k] = index.risk(users[k], query_h, query_eps);
+                });
+                reply << "OK";
+                for (float risk: risks)
+                    reply << " " << risk;
+            }
+            else if (verb == "WHATIF") {
+                if (!parse_parameters(words, query_h, query_eps, error))
+                    return "ERR " + error;
+                std::string values;
+                words >> values;
+                std::vector<float> u;
+                for (size_t begin = 0; begin <= values.size() && !values.empty();) {
+                    size_t comma = std::min(values.find(',', begin), values.size());
+                    u.push_back(strtof(values.substr(begin, comma - begin).c_str(), NULL));
+                    begin = comma + 1;
+                }
+                if (u.size() != index.features())
+                    return "ERR expected " + std::to_string(index.features()) + " features";
+                float risk = 0;
+                pool.run(1, [&](size_t) { risk = index.risk(u.data(), query_h, query_eps, true); });
+                reply << "OK " << risk;
+            }
+            else if (verb == "SHUTDOWN") {
+                // The connections are closed by serve(), after this reply
+                interrupt();
+                reply << "OK";
+            }
+            else
+                return "ERR unknown request " + verb;
+            return reply.str();
+        }
+
+        /**
+         * @brief Serves a connection until the peer closes it or the daemon stops.
+         */
+        void serve_connection(const int fd) {
+            LineReader reader(fd);
+            std::string line;
+            while (!stopping && reader.next(line)) {
+                if (line.empty())
+                    continue;
+                std::string reply = answer(line) + "\n";
+                queries++;
+                if (!send_all(fd, reply.data(), reply.size()))
+                    break;
+            }
+            std::unique_lock<std::mutex> lock(connections_mutex);
+            connections.erase(std::find(connections.begin(), connections.end(), fd));
+            close(fd);
+            closed.notify_all();
+        }
+    public:
+        // Number of requests answered
+        std::atomic<size_t> queries{ 0 };
+
+        /**
+         * @brief Construct a new daemon object.
+         *
+         * @param _index Resident dataset.
+         * @param nw Number of threads computing the risks.
+         * @param _h Default background knowledge size.
+         * @param _eps Default epsilon.
+         */
+        Daemon(RiskIndex& _index, const short& nw, const short& _h, const float& _eps):
+            index(_index), pool(std::max<short>(nw, 1)), h(_h), eps(_eps) {}
+
+        /**
+         * @brief Makes serve() return within its polling interval. Only sets a flag, so it
+         * can be called from a signal handler.
+         */
+        void interrupt() {
+            stopping = true;
+        }
+
+        /**
+         * @brief Makes serve() return, closing the open connections.
+         */
+        void stop() {
+            stopping = true;
+            std::unique_lock<std::mutex> lock(connections_mutex);
+            for (int fd: connections)
+                shutdown(fd, SHUT_RDWR);
+        }
+
+        /**
+         * @brief Listens on a Unix domain socket until stop() is called.
+         *
+         * @param path Path of the socket, replaced if it exists.
+         * @return true If the daemon has been stopped.
+         * @return false If the socket could not be created.
+         */
+        bool serve(const std::string& path) {
+            sockaddr_un address;
+            std::memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(address.sun_path))
+                return false;
+            std::strcpy(address.sun_path, path.c_str());
+            int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listener < 0)
+                return false;
+            unlink(path.c_str());
+            if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+                close(listener);
+                return false;
+            }
+            // A client that goes away shows up as a failed write, not as a signal
+            signal(SIGPIPE, SIG_IGN);
+            while (!stopping) {
+                // Wakes up now and then to notice a stop
+                pollfd listening = { listener, POLLIN, 0 };
+                if (poll(&listening, 1, 100) <= 0)
+                    continue;
+                int fd = accept(listener, NULL, NULL);
+                if (fd < 0)
+                    continue;
+                std::unique_lock<std::mutex> lock(connections_mutex);
+                connections.push_back(fd);
+                std::thread(&Daemon::serve_connection, this, fd).detach();
+            }
+            close(listener);
+            unlink(path.c_str());
+            // Waits for the connections to notice the stop
+            stop();
+            std::unique_lock<std::mutex> lock(connections_mutex);
+            closed.wait(lock, [this]() { return connections.empty(); });
+            return true;
+        }
+    };
+
+    /**
+     * @brief Connects to a Unix domain socket.
+     *
+     * @param path Path of the socket.
+     * @return int Descriptor of the connection, -1 on failure.
+     */
+    inline int connect_unix(const std::string& path) {
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+            return -1;
+        std::strcpy(address.sun_path, path.c_str());
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+} // namespace prudence
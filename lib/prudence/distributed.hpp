@@ -0,0 +1,374 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <prudence/binary.hpp>
+#include <prudence/engines.hpp>
+
+namespace prudence {
+    /**
+     * Protocol between the coordinator and a worker, over a stream socket, all integers
+     * little-endian:
+     *
+     *   setup   (coordinator -> worker): uint32 length + options line, uint64 length + binary
+     *           dataset, uint64 count + int32 weights
+     *   shard   (coordinator -> worker): uint64 begin, uint64 end; begin == end ends the worker
+     *   risks   (worker -> coordinator): uint64 begin, uint64 end, (end - begin) * width floats
+     */
+
+    /**
+     * @brief Writes the whole buffer on a descriptor.
+     * 
+     * @return true If every byte has been written.
+     * @return false If the peer is gone.
+     */
+    inline bool send_all(const int& fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+                return false;
+            data += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Reads exactly size bytes from a descriptor.
+     * 
+     * @return true If every byte has been read.
+     * @return false If the peer is gone.
+     */
+    inline bool receive_all(const int& fd, char* data, size_t size) {
+        while (size > 0) {
+            ssize_t received = read(fd, data, size);
+            if (received < 0 && errno == EINTR)
+                continue;
+            if (received <= 0)
+                return false;
+            data += received;
+            size -= received;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Sends a little-endian unsigned integer.
+     */
+    template <typename T>
+    inline bool send_le(const int& fd, const T& value) {
+        char bytes[sizeof(T)];
+        for (size_t b = 0; b < sizeof(T); b++)
+            bytes[b] = static_cast<char>((value >> (8 * b)) & 0xFF);
+        return send_all(fd, bytes, sizeof(T));
+    }
+
+    /**
+     * @brief Receives a little-endian unsigned integer.
+     */
+    template <typename T>
+    inline bool receive_le(const int& fd, T& value) {
+        char bytes[sizeof(T)];
+        if (!receive_all(fd, bytes, sizeof(T)))
+            return false;
+        value = read_le<T>(bytes);
+        return true;
+    }
+
+    /**
+     * @brief Sends a block of floats in little-endian order.
+     */
+    inline bool send_floats(const int& fd, const float* values, const size_t& count) {
+        std::vector<char> bytes(count * sizeof(float));
+        for (size_t k = 0; k < count; k++) {
+            uint32_t bits;
+            std::memcpy(&bits, &values[k], sizeof(float));
+            for (size_t b = 0; b < sizeof(float); b++)
+                bytes[k * sizeof(float) + b] = static_cast<char>((bits >> (8 * b)) & 0xFF);
+        }
+        return send_all(fd, bytes.data(), bytes.size());
+    }
+
+    /**
+     * @brief Receives a block of floats in little-endian order.
+     */
+    inline bool receive_floats(const int& fd, float* values, const size_t& count) {
+        std::vector<char> bytes(count * sizeof(float));
+        if (!receive_all(fd, bytes.data(), bytes.size()))
+            return false;
+        for (size_t k = 0; k < count; k++) {
+            uint32_t bits = read_le<uint32_t>(bytes.data() + k * sizeof(float));
+            std::memcpy(&values[k], &bits, sizeof(float));
+        }
+        return true;
+    }
+
+    /**
+     * @brief Body of a worker process: receives the setup, then computes the shards it is
+     * sent with the engine of the options, until the end message or the loss of the coordinator.
+     * 
+     * @param fd Socket connected to the coordinator.
+     * @param program Name of the executable, for the error messages.
+     * @return int Exit status of the worker.
+     */
+    inline int run_worker(const int& fd, const char* program) {
+        // Options line, parsed as a command line
+        uint32_t length;
+        if (!receive_le(fd, length))
+            return EXIT_FAILURE;
+        std::string line(length, '\0');
+        if (!receive_all(fd, &line[0], length))
+            return EXIT_FAILURE;
+        std::istringstream stream(line);
+        std::vector<std::string> words{ program };
+        for (std::string word; stream >> word;)
+            words.push_back(word);
+        std::vector<const char*> argv;
+        for (const std::string& word: words)
+            argv.push_back(word.c_str());
+        Options options;
+        if (!parse_options(argv.size(), argv.data(), options))
+            return EXIT_FAILURE;
+        // Dataset and weights
+        uint64_t size;
+        if (!receive_le(fd, size))
+            return EXIT_FAILURE;
+        std::vector<char> bytes(size);
+        if (!receive_all(fd, bytes.data(), size))
+            return EXIT_FAILURE;
+        std::vector<Record> dataset;
+        if (!parse_binary_dataset(bytes.data(), size, dataset))
+            return EXIT_FAILURE;
+        bytes = std::vector<char>();
+        uint64_t count;
+        if (!receive_le(fd, count))
+            return EXIT_FAILURE;
+        std::vector<int> weights(count);
+        for (int& weight: weights) {
+            uint32_t value;
+            if (!receive_le(fd, value))
+                return EXIT_FAILURE;
+            weight = value;
+        }
+        std::unique_ptr<Engine> engine = make_engine(options, dataset, weights);
+        if (!engine)
+            return EXIT_FAILURE;
+        size_t width = engine->width();
+        std::vector<float> risks;
+        // Number of shards computed, for the fault injection
+        int shards = 0;
+        uint64_t begin, end;
+        while (receive_le(fd, begin) && receive_le(fd, end) && begin < end) {
+            // Simulates a crash in the middle of the second shard
+            if (options.fail >= 0 && ++shards == 2)
+                _exit(EXIT_FAILURE);
+            risks.resize((end - begin) * width);
+            engine->assess_range(begin, end, risks.data());
+            if (!send_le(fd, begin) || !send_le(fd, end) || !send_floats(fd, risks.data(), risks.size()))
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    /**
+     * @brief Coordinator of local worker processes. It ships the dataset to every worker once,
+     * hands out the shards one at a time and collects the risks. A worker that dies has its
+     * shard handed out again and is replaced by a new process.
+     */
+    class Coordinator {
+    private:
+        /**
+         * @brief A worker process and its connection.
+         */
+        struct Worker {
+            pid_t pid = -1;
+            int fd = -1;
+            // Shard being computed, begin == end if idle
+            uint64_t begin = 0, end = 0;
+        };
+        // Path of the executable, started in worker mode
+        std::string executable;
+        // Options line sent to the workers
+        std::string line;
+        // Binary dataset sent to the workers
+        std::string dataset;
+        // Weights sent to the workers
+        std::vector<int> weights;
+        // Live workers
+        std::vector<Worker> workers;
+        // Index of the worker that simulates a crash, -1 for none
+        int fail;
+        // Number of workers started so far
+        int started = 0;
+
+        /**
+         * @brief Starts a worker process connected by a socket pair and sends it the setup.
+         * A failure while sending the setup shows up later, when the worker is polled.
+         * 
+         * @return true If the worker process has been started.
+         * @return false Otherwise.
+         */
+        bool spawn() {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+                return false;
+            pid_t pid = fork();
+            if (pid < 0) {
+                close(fds[0]);
+                close(fds[1]);
+                return false;
+            }
+            if (pid == 0) {
+                // The child keeps only its end and becomes a worker
+                close(fds[0]);
+                std::string flag = "--worker=" + std::to_string(fds[1]);
+                execl(executable.c_str(), executable.c_str(), flag.c_str(), (char*) NULL);
+                _exit(127);
+            }
+            close(fds[1]);
+            Worker worker;
+            worker.pid = pid;
+            worker.fd = fds[0];
+            // Only the first incarnation of the chosen worker fails
+            std::string setup = line + ((started++ == fail) ? " --fail=0" : "");
+            bool sent = send_le<uint32_t>(worker.fd, setup.size()) && send_all(worker.fd, setup.data(), setup.size())
+                && send_le<uint64_t>(worker.fd, dataset.size()) && send_all(worker.fd, dataset.data(), dataset.size())
+                && send_le<uint64_t>(worker.fd, weights.size());
+            for (size_t v = 0; v < weights.size() && sent; v++)
+                sent = send_le<uint32_t>(worker.fd, weights[v]);
+            if (!sent)
+                shutdown(worker.fd, SHUT_RDWR);
+            workers.push_back(worker);
+            return true;
+        }
+
+        /**
+         * @brief Stops tracking a worker, closing its socket and reaping the process.
+         */
+        void bury(const size_t& w) {
+            close(workers[w].fd);
+            waitpid(workers[w].pid, NULL, 0);
+            workers.erase(workers.begin() + w);
+        }
+    public:
+        // Number of workers that failed
+        int failures = 0;
+
+        /**
+         * @brief Construct a new coordinator object.
+         * 
+         * @param _executable Path of the executable, started with --worker=fd.
+         * @param _line Options line of the workers.
+         * @param records Records to send to the workers.
+         * @param feature_names Names of the features.
+         * @param _weights Weights of the records, empty if all are 1.
+         * @param _fail Index of the worker that simulates a crash, -1 for none.
+         */
+        Coordinator(
+            const std::string& _executable,
+            const std::string& _line,
+            const std::vector<Record>& records,
+            const std::vector<std::string>& feature_names,
+            const std::vector<int>& _weights,
+            const int& _fail
+        ): executable(_executable), line(_line), weights(_weights), fail(_fail) {
+            std::ostringstream stream(std::ios::binary);
+            write_binary_dataset(stream, records, feature_names);
+            dataset = stream.str();
+            // A dead worker shows up as a failed write, not as a signal
+            signal(SIGPIPE, SIG_IGN);
+        }
+
+        /**
+         * @brief Computes the risks with nw workers.
+         * 
+         * @param nw Number of worker processes.
+         * @param shards Number of shards the users are split into.
+         * @param risk_vector Matrix of risk values to fill, width values per user.
+         * @param width Number of risk values of each user.
+         * @param checkpoint If not null, only its unfinished users are computed, and the shards
+         * are recorded as they arrive.
+         * @return true If every shard has been computed.
+         * @return false If no worker could be kept alive.
+         */
+        bool run(const short& nw, const size_t& shards, std::vector<float>& risk_vector, const size_t& width, Checkpoint* checkpoint = nullptr) {
+            size_t n = risk_vector.size() / width;
+            // Shards not computed yet
+            std::deque<std::pair<uint64_t, uint64_t>> pending;
+            if (checkpoint)
+                for (const std::pair<size_t, size_t>& run: checkpoint->runs(shards))
+                    pending.push_back(run);
+            else
+                for (size_t s = 0; s < shards; s++)
+                    if (n * s / shards < n * (s + 1) / shards)
+                        pending.push_back({ n * s / shards, n * (s + 1) / shards });
+            size_t remaining = pending.size();
+            for (short w = 0; w < nw; w++)
+                spawn();
+            while (remaining > 0) {
+                // Replaces the dead workers, giving up after a replacement per original worker
+                while ((short) workers.size() < nw && failures <= nw && spawn());
+                if (workers.empty())
+                    return false;
+                // Hands out the pending shards to the idle workers
+                for (Worker& worker: workers)
+                    if (worker.begin == worker.end && !pending.empty()) {
+                        std::tie(worker.begin, worker.end) = pending.front();
+                        pending.pop_front();
+                        if (!send_le(worker.fd, worker.begin) || !send_le(worker.fd, worker.end))
+                            shutdown(worker.fd, SHUT_RDWR);
+                    }
+                // Waits for a result or a failure
+                std::vector<pollfd> fds;
+                for (Worker& worker: workers)
+                    fds.push_back({ worker.fd, POLLIN, 0 });
+                if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+                    return false;
+                for (size_t w = fds.size(); w-- > 0;) {
+                    if (!fds[w].revents)
+                        continue;
+                    Worker& worker = workers[w];
+                    uint64_t begin, end;
+                    bool valid = receive_le(worker.fd, begin) && receive_le(worker.fd, end)
+                        && begin == worker.begin && end == worker.end
+                        && receive_floats(worker.fd, risk_vector.data() + begin * width, (end - begin) * width);
+                    if (valid) {
+                        if (checkpoint)
+                            checkpoint->complete(begin, end);
+                        worker.begin = worker.end = 0;
+                        remaining--;
+                        continue;
+                    }
+                    // The shard of a failed worker goes back to the pending ones
+                    if (worker.begin < worker.end)
+                        pending.push_front({ worker.begin, worker.end });
+                    failures++;
+                    bury(w);
+                }
+            }
+            // Ends the workers
+            for (size_t w = workers.size(); w-- > 0;) {
+                send_le<uint64_t>(workers[w].fd, 0);
+                send_le<uint64_t>(workers[w].fd, 0);
+                bury(w);
+            }
+            return true;
+        }
+    };
+} // namespace prudence
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include <prudence/record.hpp>
+
+namespace prudence {
+    /**
+     * @brief Records grouped by identical feature vectors.
+     */
+    struct DuplicateGroups {
+        // One representative record for each group
+        std::vector<Record> records;
+        // Number of records in each group
+        std::vector<int> weights;
+        // Group of each record of the original dataset
+        std::vector<size_t> group;
+
+        /**
+         * @brief Expands a risk matrix computed on the groups back to the original records.
+         * 
+         * @param risks Matrix of risks of the groups, stored row by row.
+         * @param width Number of risk values of each row.
+         * @return std::vector<float> Matrix of risks of the original records.
+         */
+        std::vector<float> expand(const std::vector<float>& risks, const size_t& width) const {
+            std::vector<float> expanded(group.size() * width);
+            for (size_t i = 0; i < group.size(); i++)
+                std::copy_n(risks.begin() + group[i] * width, width, expanded.begin() + i * width);
+            return expanded;
+        }
+    };
+
+    /**
+     * @brief Groups the records whose feature vectors are bitwise identical. Such records match
+     * exactly the same candidates, so their risk can be computed once, counting each group
+     * as many times as its size.
+     * 
+     * @param dataset Dataset to collapse.
+     * @return DuplicateGroups Representatives, sizes and membership of the groups.
+     */
+    inline DuplicateGroups collapse_duplicates(const std::vector<Record>& dataset) {
+        DuplicateGroups groups;
+        groups.group.resize(dataset.size());
+        // Orders the records by their bytes so that the duplicates are adjacent
+        std::vector<size_t> order(dataset.size());
+        std::iota(order.begin(), order.end(), 0);
+        auto compare = [&dataset](const size_t& a, const size_t& b) {
+            const std::vector<float>& fa = dataset[a].features;
+            const std::vector<float>& fb = dataset[b].features;
+            if (fa.size() != fb.size())
+                return fa.size() < fb.size();
+            return std::memcmp(fa.data(), fb.data(), fa.size() * sizeof(float)) < 0;
+        };
+        std::stable_sort(order.begin(), order.end(), compare);
+        // Index of the group of each record, in the order of the first occurrence
+        std::vector<size_t> first(dataset.size());
+        for (size_t k = 0; k < order.size(); k++)
+            first[order[k]] = (k > 0 && !compare(order[k - 1], order[k])) ? first[order[k - 1]] : order[k];
+        std::vector<size_t> index(dataset.size(), SIZE_MAX);
+        for (size_t i = 0; i < dataset.size(); i++) {
+            size_t& g = index[first[i]];
+            if (g == SIZE_MAX) {
+                g = groups.records.size();
+                groups.records.push_back(dataset[i]);
+                groups.weights.push_back(0);
+            }
+            groups.weights[g]++;
+            groups.group[i] = g;
+        }
+        return groups;
+    }
+} // namespace prudence
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <prudence/utils.hpp>
+
+namespace prudence {
+    /**
+     * @brief Names of the risk columns, "Risk" for a single background knowledge size
+     * and "Risk_h1", "Risk_h2", ... for a sweep.
+     * 
+     * @param h_min Smallest background knowledge size.
+     * @param h_max Largest background knowledge size.
+     */
+    inline std::vector<std::string> risk_columns(const short& h_min, const short& h_max) {
+        if (h_min == h_max)
+            return { "Risk" };
+        std::vector<std::string> names;
+        for (short h = h_min; h <= h_max; h++)
+            names.push_back("Risk_h" + std::to_string(h));
+        return names;
+    }
+
+    /**
+     * @brief Strategy that computes the risk of the users of a dataset for every background
+     * knowledge size in [h_min, h_max]. Implementations must be safe to call concurrently on
+     * different users.
+     */
+    class Engine {
+    protected:
+        // Global view of the dataset
+        std::vector<Record>& dataset;
+        // Smallest background knowledge size
+        short h_min;
+        // Largest background knowledge size
+        short h_max;
+        // Epsilon margin for the matching
+        float eps;
+        // Number of original records represented by each record, empty if all are 1
+        std::vector<int> weights;
+
+        /**
+         * @brief Number of original records represented by a record.
+         */
+        int weight(const size_t& v) const {
+            return weights.empty() ? 1 : weights[v];
+        }
+
+        /**
+         * @brief Checks if a record matches itself on every feature. If so, once it has risk 1
+         * for a background knowledge size, it has risk 1 for every larger size.
+         * 
+         * @param i Index of the record.
+         */
+        bool self_match(const size_t& i) const {
+            Record& u = dataset[i];
+            return u.matches(u, eps, std::vector<bool>(u.features.size(), true));
+        }
+    public:
+        /**
+         * @brief Construct a new engine object.
+         * 
+         * @param _dataset Global view of the dataset.
+         * @param _h_min Smallest background knowledge size.
+         * @param _h_max Largest background knowledge size.
+         * @param _eps Epsilon margin for the matching.
+         * @param _weights Number of original records represented by each record, empty if all are 1.
+         */
+        Engine(
+            std::vector<Record>& _dataset,
+            const short& _h_min,
+            const short& _h_max,
+            const float& _eps,
+            const std::vector<int>& _weights = {}
+        ): dataset(_dataset), h_min(_h_min), h_max(_h_max), eps(_eps), weights(_weights) {}
+
+        /**
+         * @brief Destroy the engine object.
+         */
+        virtual ~Engine() {}
+
+        /**
+         * @brief Number of risk values computed for every user.
+         */
+        virtual size_t width() const {
+            return h_max - h_min + 1;
+        }
+
+        /**
+         * @brief Names of the risk columns, "Risk" for a single background knowledge size
+         * and "Risk_h1", "Risk_h2", ... for a sweep.
+         */
+        virtual std::vector<std::string> columns() const {
+            return risk_columns(h_min, h_max);
+        }
+
+        /**
+         * @brief Assesses the risk of a record in the dataset for one background knowledge size.
+         * 
+         * @param i Index of the user's record.
+         * @param h Background knowledge size.
+         * @return float Risk for the user.
+         */
+        virtual float assess_risk(size_t i, short h) const = 0;
+
+        /**
+         * @brief Assesses the risk of a record for every background knowledge size. By default
+         * the sizes are computed one by one, skipping the ones after a risk of 1.
+         * 
+         * @param i Index of the user's record.
+         * @param risks Pointer to the width() risk values of the user.
+         */
+        virtual void assess_risks(size_t i, float* risks) const {
+            bool monotone = (h_min != h_max) && self_match(i);
+            for (short h = h_min; h <= h_max; h++) {
+                size_t l = h - h_min;
+                risks[l] = (l > 0 && monotone && risks[l - 1] == 1.0) ? 1.0 : assess_risk(i, h);
+            }
+        }
+
+        /**
+         * @brief Assesses the risks of a contiguous range of records. By default the records
+         * are computed one by one.
+         * 
+         * @param begin Index of the first record.
+         * @param end Index after the last record.
+         * @param risks Pointer to the width() risk values of the first record, followed by the others.
+         */
+        virtual void assess_range(size_t begin, size_t end, float* risks) const {
+            for (size_t i = begin; i < end; i++)
+                assess_risks(i, risks + (i - begin) * width());
+        }
+
+        /**
+         * @brief Statistics collected by the engine during the computation, appended to the
+         * timing line of the executables as " Name: value" fields. Empty by default.
+         */
+        virtual std::string report() const {
+            return "";
+        }
+    };
+
+    /**
+     * @brief Engine that scans the whole dataset for every combination (the original algorithm).
+     */
+    class ScanEngine: public Engine {
+    public:
+        using Engine::Engine;
+
+        float assess_risk(size_t i, short h) const override {
+            return prudence::assess_risk(dataset[i], dataset, h, eps, weights);
+        }
+    };
+
+    /**
+     * @brief Computes the PRUDEnce algorithm in a sequential manner using an engine.
+     * 
+     * @param engine Engine that computes the risk.
+     * @param risk_vector Vector to store the risk values, width() for each user.
+     */
+    inline void sequential_algorithm(const Engine& engine, std::vector<float>& risk_vector) {
+        engine.assess_range(0, risk_vector.size() / engine.width(), risk_vector.data());
+    }
+} // namespace prudence
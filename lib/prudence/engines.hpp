@@ -0,0 +1,172 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <prudence/engine.hpp>
+#include <prudence/duplicates.hpp>
+#include <prudence/loader.hpp>
+#include <prudence/apriori.hpp>
+#include <prudence/bitset.hpp>
+#include <prudence/checkpoint.hpp>
+#include <prudence/gray.hpp>
+#include <prudence/multi_eps.hpp>
+#include <prudence/nested.hpp>
+#include <prudence/pruned.hpp>
+#include <prudence/quantized.hpp>
+#include <prudence/range.hpp>
+#include <prudence/sampled.hpp>
+#include <prudence/simd.hpp>
+#include <prudence/threshold.hpp>
+#include <prudence/tiled.hpp>
+#include <prudence/options.hpp>
+
+namespace prudence {
+    /**
+     * @brief Builds the engine selected in the options.
+     * 
+     * @param options Command line options.
+     * @param dataset Global view of the dataset.
+     * @param weights Number of original records represented by each record, empty if all are 1.
+     * @return std::unique_ptr<Engine> The engine, or nullptr after printing the reason if it cannot be built.
+     */
+    inline std::unique_ptr<Engine> make_engine(
+        const Options& options,
+        std::vector<Record>& dataset,
+        const std::vector<int>& weights = {}
+    ) {
+        if (options.prune != "none" && (options.engine != "scan" || options.eps_values.size() > 1 || options.threshold > 0 || options.top > 0 || options.sample > 0)) {
+            std::cerr << "The prunings only apply to the exact scan engine" << std::endl;
+            return nullptr;
+        }
+        if (options.eps_values.size() > 1) {
+            if (options.engine != "scan") {
+                std::cerr << "A list of epsilon values has its own engine and excludes --engine=" << options.engine << std::endl;
+                return nullptr;
+            }
+            if (options.eps_values.size() > MultiEpsEngine::MAX_VALUES || options.threshold > 0 || options.top > 0 || options.sample > 0) {
+                std::cerr << "A list of epsilon values has at most " << MultiEpsEngine::MAX_VALUES
+                          << " values, and excludes the threshold, top-k and sampled modes" << std::endl;
+                return nullptr;
+            }
+            bitset_kernel kernel = select_bitset_kernel(options.simd);
+            if (!kernel) {
+                std::cerr << "Kernel " << options.simd << " is unknown or not supported by this CPU" << std::endl;
+                return nullptr;
+            }
+            return std::make_unique<MultiEpsEngine>(dataset, options.h_min, options.h, options.eps_values, kernel, weights);
+        }
+        if (options.threshold > 0 || options.top > 0) {
+            if (options.threshold > 0 && options.top > 0) {
+                std::cerr << "The threshold and top-k modes are alternative" << std::endl;
+                return nullptr;
+            }
+            if (options.sample > 0) {
+                std::cerr << "The threshold and top-k modes need exact counts" << std::endl;
+                return nullptr;
+            }
+            if (options.h_min != options.h) {
+                std::cerr << "The threshold and top-k modes need a single background knowledge size" << std::endl;
+                return nullptr;
+            }
+            return std::make_unique<DecisionEngine>(dataset, options.h, options.eps, options.threshold, options.top, weights);
+        }
+        if (options.sample > 0) {
+            match_kernel kernel = select_kernel(options.simd);
+            if (!kernel) {
+                std::cerr << "Kernel " << options.simd << " is unknown or not supported by this CPU" << std::endl;
+                return nullptr;
+            }
+            return std::make_unique<SampledEngine>(
+                dataset, options.h_min, options.h, options.eps, options.sample, options.stratified,
+                options.sample_combinations, options.seed, kernel, options.validate, weights
+            );
+        }
+        if (options.engine == "scan" && options.prune != "none") {
+            bool bounded = options.prune == "bound" || options.prune == "all";
+            bool ordered = options.prune == "order" || options.prune == "all";
+            return std::make_unique<PrunedScanEngine>(dataset, options.h_min, options.h, options.eps, bounded, ordered, weights);
+        }
+        if (options.engine == "scan") {
+            // Threads per user, only worth when the users don't fill the workers and each
+            // thread gets a fair share of the combinations
+            short threads = (options.nested < 0) ? 1 : (options.nested > 0) ? options.nested : nested_threads(options.nw, dataset.size());
+            size_t m = dataset.empty() ? 0 : dataset[0].features.size();
+            bool worth = options.nested > 0 || CombinationsEnumerator::binomial(m, options.h_min) >= 64 * (uint64_t) threads;
+            if (threads > 1 && worth) {
+                // Workers that can be on a user at the same time
+                short callers = std::min<size_t>(std::max<short>(options.nw, 1), dataset.size());
+                return std::make_unique<NestedEngine>(dataset, options.h_min, options.h, options.eps, threads, callers, weights);
+            }
+            return std::make_unique<ScanEngine>(dataset, options.h_min, options.h, options.eps, weights);
+        }
+        if (options.engine == "bitset")
+            return std::make_unique<BitsetEngine>(dataset, options.h_min, options.h, options.eps, weights);
+        if (options.engine == "apriori")
+            return std::make_unique<AprioriEngine>(dataset, options.h_min, options.h, options.eps, weights);
+        if (options.engine == "gray") {
+            if (options.h > 255) {
+                std::cerr << "The gray engine supports background knowledge sizes up to 255" << std::endl;
+                return nullptr;
+            }
+            return std::make_unique<GrayEngine>(dataset, options.h_min, options.h, options.eps, weights);
+        }
+        if (options.engine == "range")
+            return std::make_unique<RangeEngine>(dataset, options.h_min, options.h, options.eps, weights);
+        if (options.engine == "simd" || options.engine == "tiled") {
+            match_kernel kernel = select_kernel(options.simd);
+            if (!kernel) {
+                std::cerr << "Kernel " << options.simd << " is unknown or not supported by this CPU" << std::endl;
+                return nullptr;
+            }
+            if (options.engine == "tiled")
+                return std::make_unique<TiledEngine>(dataset, options.h_min, options.h, options.eps, kernel, weights);
+            return std::make_unique<SimdEngine>(dataset, options.h_min, options.h, options.eps, kernel, weights);
+        }
+        if (options.engine == "quantized") {
+            Quantization quantization = quantize(dataset, options.eps, options.bits);
+            if (quantization.bits == 8) {
+                code_kernel<uint8_t> kernel = select_code_kernel<uint8_t>(options.simd);
+                if (kernel)
+                    return std::make_unique<QuantizedEngine<uint8_t>>(
+                        dataset, options.h_min, options.h, options.eps, std::move(quantization), kernel, options.validate, weights
+                    );
+            }
+            else {
+                code_kernel<uint16_t> kernel = select_code_kernel<uint16_t>(options.simd);
+                if (kernel)
+                    return std::make_unique<QuantizedEngine<uint16_t>>(
+                        dataset, options.h_min, options.h, options.eps, std::move(quantization), kernel, options.validate, weights
+                    );
+            }
+            std::cerr << "Kernel " << options.simd << " is unknown or not supported by this CPU" << std::endl;
+            return nullptr;
+        }
+        std::cerr << "Unknown engine " << options.engine << std::endl;
+        return nullptr;
+    }
+
+    /**
+     * @brief Writes the risks computed by the engine selected in the options: every user, or
+     * only the selected ones in the threshold and top-k modes.
+     * 
+     * @param options Command line options.
+     * @param dataset Dataset to read the usernames.
+     * @param risks Matrix of risks, stored row by row.
+     * @param engine Engine that computed the risks.
+     * @param output_stream Stream to write data on a file.
+     */
+    inline void write_output(
+        const Options& options,
+        const std::vector<Record>& dataset,
+        const std::vector<float>& risks,
+        const Engine& engine,
+        std::ofstream& output_stream
+    ) {
+        if (options.threshold > 0 || options.top > 0)
+            write_selected(dataset, risks, options.threshold, options.top, output_stream);
+        else
+            write_risk(dataset, risks, engine.columns(), output_stream);
+    }
+} // namespace prudence
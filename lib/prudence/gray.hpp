@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+#include <combinations.hpp>
+#include <prudence/columnar.hpp>
+#include <prudence/engine.hpp>
+
+namespace prudence {
+    /**
+     * @brief Engine that walks the combinations in revolving-door order, where every step swaps
+     * one feature out and one in. For every candidate it keeps the number of features of the
+     * current combination that the candidate fails, so a step only reads the columns of the two
+     * swapped features, and the matches are the candidates with no failure.
+     */
+    class GrayEngine: public Engine {
+    private:
+        // Columnar copy of the dataset
+        ColumnarDataset columns;
+
+        /**
+         * @brief Walks the combinations of h features on the failures of a user.
+         *
+         * @param fails Failures of the candidates, one column of n flags per feature.
+         * @param h Background knowledge size, at most 255.
+         * @return float Risk for the user.
+         */
+        float assess_fails(const std::vector<uint8_t>& fails, const short& h) const {
+            size_t n = columns.size();
+            size_t m = columns.features();
+            const int* w = weights.empty() ? nullptr : weights.data();
+            // Number of features of the combination failed by each candidate
+            std::vector<uint8_t> failed(n, 0);
+            // A size larger than the features selects all of them, like CombinationsEnumerator
+            short size = std::min<size_t>(h, m);
+            RevolvingDoorEnumerator comb(m, size);
+            for (short k = 0; k < size; k++) {
+                const uint8_t* column = fails.data() + comb[k] * n;
+                for (size_t v = 0; v < n; v++)
+                    failed[v] += column[v];
+            }
+            // Number of matches for the first combination
+            int matches = 0;
+            for (size_t v = 0; v < n; v++)
+                matches += (failed[v] == 0) * (w ? w[v] : 1);
+            // Minimum number of matches for a combination
+            int min_matches = INT_MAX;
+            while (true) {
+                // If we have only 1 match the combination gives the risk
+                if (matches == 1)
+                    return 1.0;
+                // Else we take the minimum number of matches found
+                if (matches < min_matches)
+                    min_matches = matches;
+                if (!comb.next())
+                    break;
+                // Swaps the columns of the removed and added features
+                const uint8_t* out = fails.data() + comb.removed * n;
+                const uint8_t* in = fails.data() + comb.added * n;
+                matches = 0;
+                if (w)
+                    for (size_t v = 0; v < n; v++) {
+                        failed[v] += in[v] - out[v];
+                        matches += (failed[v] == 0) * w[v];
+                    }
+                else
+                    for (size_t v = 0; v < n; v++) {
+                        failed[v] += in[v] - out[v];
+                        matches += failed[v] == 0;
+                    }
+            }
+            // Risk is the inverse of the minimum number of matches
+            return 1.0 / min_matches;
+        }
+
+        /**
+         * @brief Failures of every candidate against a user, one column per feature.
+         */
+        std::vector<uint8_t> failures(const size_t& i) const {
+            size_t n = columns.size();
+            size_t m = columns.features();
+            const float* u = dataset[i].features.data();
+            std::vector<uint8_t> fails(m * n);
+            for (size_t j = 0; j < m; j++) {
+                const float* column = columns.column(j);
+                uint8_t* out = fails.data() + j * n;
+                for (size_t v = 0; v < n; v++) {
+                    // Same bounds of Record::matches
+                    float lo = column[v] - column[v] * eps;
+                    float hi = column[v] + column[v] * eps;
+                    out[v] = u[j] < lo || u[j] > hi;
+                }
+            }
+            return fails;
+        }
+    public:
+        /**
+         * @brief Construct a new revolving-door engine object.
+         *
+         * @param _dataset Global view of the dataset.
+         * @param _h_min Smallest background knowledge size.
+         * @param _h_max Largest background knowledge size, at most 255.
+         * @param _eps Epsilon margin for the matching.
+         * @param _weights Number of original records represented by each record, empty if all are 1.
+         */
+        GrayEngine(
+            std::vector<Record>& _dataset,
+            const short& _h_min,
+            const short& _h_max,
+            const float& _eps,
+            const std::vector<int>& _weights = {}
+        ): Engine(_dataset, _h_min, _h_max, _eps, _weights), columns(_dataset) {}
+
+        float assess_risk(size_t i, short h) const override {
+            return assess_fails(failures(i), h);
+        }
+
+        /**
+         * @brief Computes the failures of the user once for every background knowledge size.
+         */
+        void assess_risks(size_t i, float* risks) const override {
+            bool monotone = (h_min != h_max) && self_match(i);
+            std::vector<uint8_t> fails = failures(i);
+            for (short h = h_min; h <= h_max; h++) {
+                size_t l = h - h_min;
+                risks[l] = (l > 0 && monotone && risks[l - 1] == 1.0) ? 1.0 : assess_fails(fails, h);
+            }
+        }
+    };
+} // namespace prudence
@@ -0,0 +1,380 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <combinations.hpp>
+#include <prudence/binary.hpp>
+#include <prudence/record.hpp>
+
+namespace prudence {
+    /**
+     * State file of the incremental mode, all integers little-endian:
+     *
+     *   magic "PRUDSTA\0" | uint32 version | int16 h_min | int16 h_max | uint32 eps bits
+     *   uint64 length + binary dataset (see binary.hpp)
+     *   uint8 bytes per count (2 or 4) | n rows of counts, one per combination of every size
+     */
+
+    // Magic bytes at the beginning of a state file
+    constexpr char STATE_MAGIC[8] = { 'P', 'R', 'U', 'D', 'S', 'T', 'A', '\0' };
+    // Current version of the state file
+    constexpr uint32_t STATE_VERSION = 1;
+
+    /**
+     * @brief Number of matches of every user on every combination, which makes the risks
+     * updatable when records are appended or removed. A candidate v contributes to the count of
+     * a user u on exactly the combinations made of features on which u matches v, so a change
+     * of v only touches the users matching it on some feature, found by binary search on the
+     * sorted feature values, and on those users only the subsets of their matching features.
+     */
+    class IncrementalState {
+    private:
+        // Number of combinations of all the sizes
+        size_t total = 0;
+        // Index of the first combination of each size, plus the total
+        std::vector<size_t> first;
+        // Number of features of the combinations of each size
+        std::vector<int> sizes;
+        // Sorted values of each feature with the user index, NaN excluded
+        std::vector<std::vector<std::pair<float, size_t>>> sorted;
+        // Users with a NaN on each feature, that match every candidate on it
+        std::vector<std::vector<size_t>> missing;
+        // Users whose counts have been updated since the state has been built or loaded
+        std::vector<bool> dirty;
+
+        /**
+         * @brief Sets up the combination layout for the sizes and the features.
+         */
+        void layout() {
+            size_t m = feature_names.size();
+            first.assign(1, 0);
+            sizes.clear();
+            for (short h = h_min; h <= h_max; h++) {
+                // A size larger than the features selects all of them, like CombinationsEnumerator
+                sizes.push_back(std::min<size_t>(h, m));
+                first.push_back(first.back() + CombinationsEnumerator::binomial(m, sizes.back()));
+            }
+            total = first.back();
+        }
+
+        /**
+         * @brief Features on which the user u matches the candidate v, as a bit mask.
+         */
+        uint64_t match_mask(const Record& u, const Record& v) const {
+            uint64_t mask = 0;
+            for (size_t j = 0; j < u.features.size(); j++) {
+                float lo = v.features[j] - v.features[j] * eps;
+                float hi = v.features[j] + v.features[j] * eps;
+                if (!(u.features[j] < lo || u.features[j] > hi))
+                    mask |= uint64_t(1) << j;
+            }
+            return mask;
+        }
+
+        /**
+         * @brief Adds delta to the counts of a user on every combination within a feature mask.
+         */
+        void update(const size_t& u, const uint64_t& mask, const int& delta) {
+            size_t m = feature_names.size();
+            std::vector<int> features;
+            for (size_t j = 0; j < m; j++)
+                if (mask >> j & 1)
+                    features.push_back(j);
+            int p = features.size();
+            uint32_t* row = &counts[u * total];
+            for (size_t l = 0; l < sizes.size(); l++) {
+                int k = sizes[l];
+                if (p < k)
+                    continue;
+                uint64_t last = CombinationsEnumerator::binomial(m, k) - 1;
+                // Walks the subsets of size k of the matching features, lexicographically
+                std::vector<int> pick(k);
+                std::iota(pick.begin(), pick.end(), 0);
+                while (true) {
+                    // Lexicographic rank among the combinations of k out of m features
+                    uint64_t rank = last;
+                    for (int i = 0; i < k; i++)
+                        rank -= CombinationsEnumerator::binomial(m - 1 - features[pick[i]], k - i);
+                    row[first[l] + rank] += delta;
+                    int i = k - 1;
+                    while (i >= 0 && pick[i] == p - k + i)
+                        i--;
+                    if (i < 0)
+                        break;
+                    pick[i]++;
+                    for (int r = i + 1; r < k; r++)
+                        pick[r] = pick[r - 1] + 1;
+                }
+            }
+        }
+
+        /**
+         * @brief Sorts the values of every feature, to find the users matching a candidate.
+         */
+        void index() {
+            size_t m = feature_names.size();
+            sorted.assign(m, {});
+            missing.assign(m, {});
+            for (size_t j = 0; j < m; j++) {
+                for (size_t u = 0; u < dataset.size(); u++) {
+                    float x = dataset[u].features[j];
+                    if (std::isnan(x))
+                        missing[j].push_back(u);
+                    else
+                        sorted[j].push_back({ x, u });
+                }
+                std::sort(sorted[j].begin(), sorted[j].end());
+            }
+        }
+
+        /**
+         * @brief Users (among the indexed ones) matching a candidate on at least one feature.
+         */
+        std::vector<size_t> matching_users(const Record& v) const {
+            std::vector<size_t> users;
+            for (size_t j = 0; j < sorted.size(); j++) {
+                float x = v.features[j];
+                users.insert(users.end(), missing[j].begin(), missing[j].end());
+                if (std::isnan(x)) {
+                    for (const std::pair<float, size_t>& entry: sorted[j])
+                        users.push_back(entry.second);
+                    continue;
+                }
+                float lo = x - x * eps;
+                float hi = x + x * eps;
+                if (lo > hi)
+                    continue;
+                // Widened bounds, the exact check is done by match_mask
+                float slack = 1e-6f * std::max(std::fabs(lo), std::fabs(hi));
+                auto begin = std::lower_bound(sorted[j].begin(), sorted[j].end(), std::make_pair(lo - slack, (size_t) 0));
+                auto end = std::upper_bound(begin, sorted[j].end(), std::make_pair(hi + slack, SIZE_MAX));
+                for (auto entry = begin; entry != end; entry++)
+                    users.push_back(entry->second);
+            }
+            std::sort(users.begin(), users.end());
+            users.erase(std::unique(users.begin(), users.end()), users.end());
+            return users;
+        }
+
+        /**
+         * @brief Computes the counts of a range of users against every record.
+         */
+        void count_users(const size_t& begin, const size_t& end) {
+            for (size_t u = begin; u < end; u++)
+                for (const Record& v: dataset)
+                    update(u, match_mask(dataset[u], v), 1);
+        }
+    public:
+        // Smallest background knowledge size
+        short h_min = 0;
+        // Largest background knowledge size
+        short h_max = 0;
+        // Epsilon margin for the matching
+        float eps = 0;
+        // Records of the current dataset
+        std::vector<Record> dataset;
+        // Names of the features
+        std::vector<std::string> feature_names;
+        // Number of matches, one row of combinations per user
+        std::vector<uint32_t> counts;
+
+        /**
+         * @brief Largest number of features supported by the feature masks.
+         */
+        static constexpr size_t MAX_FEATURES = 64;
+
+        /**
+         * @brief Computes the counts of a whole dataset from scratch.
+         * 
+         * @param _dataset Records of the dataset.
+         * @param _feature_names Names of the features.
+         * @param _h_min Smallest background knowledge size.
+         * @param _h_max Largest background knowledge size.
+         * @param _eps Epsilon margin for the matching.
+         * @param threads Number of threads sharing the users.
+         */
+        void build(
+            const std::vector<Record>& _dataset,
+            const std::vector<std::string>& _feature_names,
+            const short& _h_min,
+            const short& _h_max,
+            const float& _eps,
+            const int& threads
+        ) {
+            dataset = _dataset;
+            feature_names = _feature_names;
+            h_min = _h_min;
+            h_max = _h_max;
+            eps = _eps;
+            layout();
+            counts.assign(dataset.size() * total, 0);
+            size_t n = dataset.size(), nt = std::max(threads, 1);
+            std::vector<std::thread> workers;
+            for (size_t t = 1; t < nt; t++)
+                workers.emplace_back(&IncrementalState::count_users, this, n * t / nt, n * (t + 1) / nt);
+            count_users(0, n / nt);
+            for (std::thread& w: workers)
+                w.join();
+            dirty.assign(n, true);
+        }
+
+        /**
+         * @brief Removes the records with the given IDs, updating the users that matched them.
+         * 
+         * @param ids IDs of the records to remove.
+         */
+        void remove(const std::unordered_set<std::string>& ids) {
+            index();
+            std::vector<bool> removed(dataset.size(), false);
+            for (size_t v = 0; v < dataset.size(); v++)
+                removed[v] = ids.count(dataset[v].id) > 0;
+            for (size_t v = 0; v < dataset.size(); v++) {
+                if (!removed[v])
+                    continue;
+                for (size_t u: matching_users(dataset[v]))
+                    if (!removed[u]) {
+                        update(u, match_mask(dataset[u], dataset[v]), -1);
+                        dirty[u] = true;
+                    }
+            }
+            // Compacts records and counts
+            size_t kept = 0;
+            for (size_t v = 0; v < dataset.size(); v++) {
+                if (removed[v])
+                    continue;
+                if (kept != v) {
+                    dirty[kept] = dirty[v];
+                    dataset[kept] = std::move(dataset[v]);
+                    std::copy_n(counts.begin() + v * total, total, counts.begin() + kept * total);
+                }
+                kept++;
+            }
+            dataset.resize(kept);
+            dirty.resize(kept);
+            counts.resize(kept * total);
+        }
+
+        /**
+         * @brief Appends records, updating the users that match them and counting the new users.
+         * 
+         * @param records Records to append.
+         */
+        void append(const std::vector<Record>& records) {
+            index();
+            size_t n = dataset.size();
+            for (const Record& v: records)
+                for (size_t u: matching_users(v)) {
+                    update(u, match_mask(dataset[u], v), 1);
+                    dirty[u] = true;
+                }
+            dataset.insert(dataset.end(), records.begin(), records.end());
+            dirty.resize(dataset.size(), true);
+            counts.resize(dataset.size() * total, 0);
+            count_users(n, dataset.size());
+        }
+
+        /**
+         * @brief Number of users whose counts have been updated since the state has been built or loaded.
+         */
+        size_t affected() const {
+            return std::count(dirty.begin(), dirty.end(), true);
+        }
+
+        /**
+         * @brief Risks of every user from the counts, one row of sizes per user.
+         */
+        std::vector<float> risks() const {
+            size_t width = sizes.size();
+            std::vector<float> risk_vector(dataset.size() * width);
+            for (size_t u = 0; u < dataset.size(); u++)
+                for (size_t l = 0; l < width; l++) {
+                    auto begin = counts.begin() + u * total + first[l], end = counts.begin() + u * total + first[l + 1];
+                    // A single match gives the risk, as in the scan, even if another combination has none
+                    if (std::find(begin, end, 1u) != end)
+                        risk_vector[u * width + l] = 1.0;
+                    else
+                        // Risk is the inverse of the minimum number of matches
+                        risk_vector[u * width + l] = 1.0 / (int) *std::min_element(begin, end);
+                }
+            return risk_vector;
+        }
+
+        /**
+         * @brief Writes the state, with 2-byte counts when the dataset allows them.
+         * 
+         * @param path Path of the state file.
+         * @return true If the file has been written.
+         * @return false Otherwise.
+         */
+        bool save(const std::string& path) const {
+            std::ofstream output_stream(path, std::ios::binary);
+            if (!output_stream.is_open())
+                return false;
+            output_stream.write(STATE_MAGIC, sizeof(STATE_MAGIC));
+            write_le<uint32_t>(output_stream, STATE_VERSION);
+            write_le<uint16_t>(output_stream, h_min);
+            write_le<uint16_t>(output_stream, h_max);
+            uint32_t bits;
+            std::memcpy(&bits, &eps, sizeof(float));
+            write_le<uint32_t>(output_stream, bits);
+            std::ostringstream binary(std::ios::binary);
+            write_binary_dataset(binary, dataset, feature_names);
+            write_le<uint64_t>(output_stream, binary.str().size());
+            output_stream << binary.str();
+            uint8_t width = dataset.size() <= UINT16_MAX ? 2 : 4;
+            output_stream.put(width);
+            for (uint32_t count: counts) {
+                if (width == 2)
+                    write_le<uint16_t>(output_stream, count);
+                else
+                    write_le<uint32_t>(output_stream, count);
+            }
+            return output_stream.good();
+        }
+
+        /**
+         * @brief Reads a state written by save.
+         * 
+         * @param path Path of the state file.
+         * @return true If the file is a valid state.
+         * @return false Otherwise.
+         */
+        bool load(const std::string& path) {
+            std::ifstream input_stream(path, std::ios::binary);
+            std::string content((std::istreambuf_iterator<char>(input_stream)), std::istreambuf_iterator<char>());
+            const char* data = content.data();
+            size_t offset = sizeof(STATE_MAGIC) + 12;
+            if (content.size() < offset + 8 || std::memcmp(data, STATE_MAGIC, sizeof(STATE_MAGIC)) != 0
+                || read_le<uint32_t>(data + 8) != STATE_VERSION)
+                return false;
+            h_min = (short) read_le<uint16_t>(data + 12);
+            h_max = (short) read_le<uint16_t>(data + 14);
+            uint32_t bits = read_le<uint32_t>(data + 16);
+            std::memcpy(&eps, &bits, sizeof(float));
+            uint64_t length = read_le<uint64_t>(data + offset);
+            offset += 8;
+            if (content.size() < offset + length + 1 || !parse_binary_dataset(data + offset, length, dataset, &feature_names))
+                return false;
+            offset += length;
+            layout();
+            size_t width = data[offset++];
+            if ((width != 2 && width != 4) || content.size() < offset + dataset.size() * total * width)
+                return false;
+            counts.resize(dataset.size() * total);
+            for (size_t k = 0; k < counts.size(); k++)
+                counts[k] = (width == 2) ? read_le<uint16_t>(data + offset + 2 * k) : read_le<uint32_t>(data + offset + 4 * k);
+            dirty.assign(dataset.size(), false);
+            return true;
+        }
+    };
+} // namespace prudence
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <prudence/binary.hpp>
+#include <prudence/record.hpp>
+
+namespace prudence {
+    /**
+     * @brief Read-only memory mapping of a whole file, released using RAII.
+     */
+    class MappedFile {
+    private:
+        // Descriptor of the file
+        int fd = -1;
+        // Beginning of the mapping
+        void* data = MAP_FAILED;
+        // Size of the file in bytes
+        size_t length = 0;
+    public:
+        /**
+         * @brief Maps a file in memory.
+         * 
+         * @param path Path of the file.
+         */
+        MappedFile(const std::string& path) {
+            fd = open(path.c_str(), O_RDONLY);
+            struct stat info;
+            if (fd < 0 || fstat(fd, &info) != 0)
+                return;
+            length = info.st_size;
+            // An empty file cannot be mapped, but it is a valid (empty) input
+            if (length == 0)
+                return;
+            data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+                madvise(data, length, MADV_SEQUENTIAL);
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /**
+         * @brief Unmaps and closes the file.
+         */
+        ~MappedFile() {
+            if (data != MAP_FAILED)
+                munmap(data, length);
+            if (fd >= 0)
+                close(fd);
+        }
+
+        /**
+         * @brief Checks if the file has been opened and mapped.
+         */
+        bool is_open() const {
+            return fd >= 0 && (length == 0 || data != MAP_FAILED);
+        }
+
+        /**
+         * @brief Beginning of the content.
+         */
+        const char* begin() const {
+            return data == MAP_FAILED ? nullptr : static_cast<const char*>(data);
+        }
+
+        /**
+         * @brief Size of the content in bytes.
+         */
+        size_t size() const {
+            return length;
+        }
+    };
+
+    /**
+     * @brief Parses a float cell. Falls back to strtof for the syntax that std::from_chars
+     * does not accept (e.g. a leading '+' or an empty cell), so values are those of Record.
+     * 
+     * @param begin First character of the cell.
+     * @param end One past the last character of the cell.
+     * @return float Value of the cell.
+     */
+    inline float parse_cell(const char* begin, const char* end) {
+        float value;
+        std::from_chars_result result = std::from_chars(begin, end, value);
+        if (result.ec == std::errc() && result.ptr == end)
+            return value;
+        std::string cell(begin, end);
+        return strtof(cell.c_str(), NULL);
+    }
+
+    /**
+     * @brief Parses a CSV row into a record whose features are already allocated.
+     * 
+     * @param begin First character of the row.
+     * @param end One past the last character of the row, newline excluded.
+     * @param id_index Index of the column representing the ID, starting from 0.
+     * @param record Record to fill.
+     */
+    inline void parse_row(const char* begin, const char* end, const int& id_index, Record& record) {
+        size_t j = 0;
+        int column = 0;
+        while (begin <= end) {
+            const char* comma = static_cast<const char*>(memchr(begin, ',', end - begin));
+            if (!comma)
+                comma = end;
+            if (column == id_index)
+                record.id.assign(begin, comma);
+            else if (j < record.features.size())
+                record.features[j++] = parse_cell(begin, comma);
+            begin = comma + 1;
+            column++;
+        }
+    }
+
+    /**
+     * @brief Loads a dataset by mapping it in memory. A binary dataset (see binary.hpp) is read
+     * directly from the mapping. A CSV dataset is split in newline-aligned chunks parsed in
+     * parallel, straight into preallocated records; the number of features comes from the header.
+     * 
+     * @param path Path of the CSV or binary file.
+     * @param id_index Index of the column that has to be accounted as ID for the record (CSV only).
+     * @param threads Number of parsing threads.
+     * @param dataset Vector of records to fill.
+     * @param bytes Size of the file in bytes.
+     * @param feature_names If not null, filled with the names of the features.
+     * @return true If the file has been loaded.
+     * @return false If the file could not be opened or is not a valid binary dataset.
+     */
+    inline bool load_dataset(
+        const std::string& path,
+        const int& id_index,
+        const int& threads,
+        std::vector<Record>& dataset,
+        size_t& bytes,
+        std::vector<std::string>* feature_names = nullptr
+    ) {
+        MappedFile file(path);
+        if (!file.is_open())
+            return false;
+        bytes = file.size();
+        dataset.clear();
+        if (bytes == 0)
+            return true;
+        const char* text = file.begin();
+        const char* text_end = text + bytes;
+        if (is_binary_dataset(text, bytes))
+            return parse_binary_dataset(text, bytes, dataset, feature_names);
+        // The header gives the number of columns
+        const char* header_end = std::find(text, text_end, '\n');
+        size_t m = std::count(text, header_end, ',');
+        if (feature_names) {
+            std::vector<std::string> names;
+            // Splits the header on commas, skipping the ID column
+            const char* cell = text;
+            for (int column = 0; cell <= header_end; column++) {
+                const char* comma = std::find(cell, header_end, ',');
+                const char* cell_end = (comma > cell && comma[-1] == '\r') ? comma - 1 : comma;
+                if (column != id_index)
+                    names.emplace_back(cell, cell_end);
+                cell = comma + 1;
+            }
+            *feature_names = std::move(names);
+        }
+        const char* body = std::min(header_end + 1, text_end);
+        // Splits the body in newline-aligned chunks
+        size_t nt = std::max(1, threads);
+        std::vector<const char*> bounds(nt + 1, text_end);
+        bounds[0] = body;
+        for (size_t t = 1; t < nt; t++) {
+            const char* guess = std::max(bounds[t - 1], body + (text_end - body) * t / nt);
+            const char* newline = std::find(guess, text_end, '\n');
+            bounds[t] = std::min(newline + (newline != text_end), text_end);
+        }
+        // Runs a function on every chunk in parallel
+        auto parallel = [&nt](auto&& function) {
+            std::vector<std::thread> workers;
+            for (size_t t = 1; t < nt; t++)
+                workers.emplace_back(function, t);
+            function(0);
+            for (std::thread& w: workers)
+                w.join();
+        };
+        // Calls a function on every non-empty row of a chunk
+        auto for_each_row = [&bounds](const size_t& t, auto&& function) {
+            const char* row = bounds[t];
+            while (row < bounds[t + 1]) {
+                const char* newline = static_cast<const char*>(memchr(row, '\n', bounds[t + 1] - row));
+                const char* row_end = newline ? newline : bounds[t + 1];
+                const char* next = newline ? newline + 1 : row_end;
+                // Drops the carriage return of Windows line endings
+                if (row_end > row && row_end[-1] == '\r')
+                    row_end--;
+                if (row_end > row)
+                    function(row, row_end);
+                row = next;
+            }
+        };
+        // Counts the rows of every chunk
+        std::vector<size_t> offsets(nt + 1, 0);
+        parallel([&](const size_t& t) {
+            for_each_row(t, [&](const char*, const char*) { offsets[t + 1]++; });
+        });
+        for (size_t t = 0; t < nt; t++)
+            offsets[t + 1] += offsets[t];
+        // Parses the rows straight into their records
+        dataset.resize(offsets[nt]);
+        parallel([&](const size_t& t) {
+            size_t i = offsets[t];
+            for_each_row(t, [&](const char* row, const char* row_end) {
+                Record& record = dataset[i++];
+                record.features.assign(m, 0);
+                parse_row(row, row_end, id_index, record);
+            });
+        });
+        return true;
+    }
+} // namespace prudence
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <immintrin.h>
+
+#include <combinations.hpp>
+#include <prudence/columnar.hpp>
+#include <prudence/engine.hpp>
+
+namespace prudence {
+    /**
+     * @brief Kernel that fills the bitset of the candidates matching a user value on a feature.
+     * 
+     * @param column Column of the feature, padded to a multiple of 16 values.
+     * @param u Value of the user.
+     * @param eps Epsilon margin for the matching.
+     * @param n Number of candidates.
+     * @param row Bitset to fill, (n + 63) / 64 words.
+     */
+    using bitset_kernel = void (*)(const float*, const float&, const float&, const size_t&, uint64_t*);
+
+    /**
+     * @brief Scalar bitset kernel.
+     */
+    inline void match_bitset_scalar(const float* column, const float& u, const float& eps, const size_t& n, uint64_t* row) {
+        for (size_t w = 0; w < (n + 63) / 64; w++) {
+            uint64_t word = 0;
+            for (size_t b = 0, v = w * 64; b < 64 && v < n; b++, v++) {
+                float lo = column[v] - column[v] * eps;
+                float hi = column[v] + column[v] * eps;
+                word |= uint64_t(!(u < lo || u > hi)) << b;
+            }
+            row[w] = word;
+        }
+    }
+
+    /**
+     * @brief AVX2 bitset kernel, 8 candidates per instruction.
+     */
+    __attribute__((target("avx2")))
+    inline void match_bitset_avx2(const float* column, const float& u, const float& eps, const size_t& n, uint64_t* row) {
+        const __m256 veps = _mm256_set1_ps(eps);
+        const __m256 vu = _mm256_set1_ps(u);
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(row);
+        for (size_t v = 0; v < n; v += 8) {
+            __m256 value = _mm256_load_ps(column + v);
+            __m256 delta = _mm256_mul_ps(value, veps);
+            __m256 lo = _mm256_sub_ps(value, delta);
+            __m256 hi = _mm256_add_ps(value, delta);
+            // Negated comparisons keep the semantics of Record::matches
+            __m256 mask = _mm256_and_ps(_mm256_cmp_ps(vu, lo, _CMP_NLT_UQ), _mm256_cmp_ps(vu, hi, _CMP_NGT_UQ));
+            bytes[v / 8] = _mm256_movemask_ps(mask);
+        }
+        // Clears the padding candidates
+        if (n % 64)
+            row[n / 64] &= (uint64_t(1) << (n % 64)) - 1;
+    }
+
+    /**
+     * @brief AVX-512 bitset kernel, 16 candidates per instruction.
+     */
+    __attribute__((target("avx512f")))
+    inline void match_bitset_avx512(const float* column, const float& u, const float& eps, const size_t& n, uint64_t* row) {
+        const __m512 veps = _mm512_set1_ps(eps);
+        const __m512 vu = _mm512_set1_ps(u);
+        uint16_t* halves = reinterpret_cast<uint16_t*>(row);
+        for (size_t v = 0; v < n; v += 16) {
+            __m512 value = _mm512_load_ps(column + v);
+            // The explicit rounding keeps the product from being fused with the following add/sub
+            __m512 delta = _mm512_maskz_mul_round_ps(0xFFFF, value, veps, _MM_FROUND_CUR_DIRECTION);
+            __m512 lo = _mm512_sub_ps(value, delta);
+            __m512 hi = _mm512_add_ps(value, delta);
+            // Negated comparisons keep the semantics of Record::matches
+            __mmask16 mask = _mm512_cmp_ps_mask(vu, lo, _CMP_NLT_UQ);
+            halves[v / 16] = _mm512_mask_cmp_ps_mask(mask, vu, hi, _CMP_NGT_UQ);
+        }
+        // Clears the padding candidates
+        if (n % 64)
+            row[n / 64] &= (uint64_t(1) << (n % 64)) - 1;
+    }
+
+    /**
+     * @brief Selects the widest bitset kernel supported by the CPU.
+     * 
+     * @param name One of "auto", "avx512", "avx2" and "scalar".
+     * @return bitset_kernel The kernel, or nullptr if the name is unknown or not supported.
+     */
+    inline bitset_kernel select_bitset_kernel(const std::string& name) {
+        __builtin_cpu_init();
+        bool avx512 = __builtin_cpu_supports("avx512f");
+        bool avx2 = __builtin_cpu_supports("avx2");
+        if (name == "avx512" || (name == "auto" && avx512))
+            return avx512 ? match_bitset_avx512 : nullptr;
+        if (name == "avx2" || (name == "auto" && avx2))
+            return avx2 ? match_bitset_avx2 : nullptr;
+        if (name == "scalar" || name == "auto")
+            return match_bitset_scalar;
+        return nullptr;
+    }
+
+    /**
+     * @brief Engine that computes the risks for several epsilon values in a single traversal.
+     * For every user, each feature gets a bitset per epsilon of the candidates that match it,
+     * with the same bounds of Record::matches, so the user is compared with each candidate once.
+     * The count of a combination is then the popcount of the AND of the bitsets of its features.
+     * With positive epsilons the matching intervals are nested, so on large datasets the epsilons
+     * are counted from the widest and each narrower one only visits the words left nonzero by the
+     * wider one.
+     * The combinations of a user stop once every epsilon has risk 1.
+     * The risks of a user are stored size by size, and within a size epsilon by epsilon.
+     */
+    class MultiEpsEngine: public Engine {
+    private:
+        // Epsilon values, at most MAX_VALUES
+        std::vector<float> values;
+        // Indices of the positive epsilon values from the widest to the narrowest, then the others
+        std::vector<size_t> order;
+        // Columnar copy of the dataset
+        ColumnarDataset data;
+        // Kernel that fills the bitsets
+        bitset_kernel kernel;
+
+        /**
+         * @brief AND of a word of the rows of a combination.
+         */
+        static uint64_t intersect(const std::vector<const uint64_t*>& rows, const size_t& w) {
+            uint64_t word = rows[0][w];
+            for (size_t k = 1; k < rows.size(); k++)
+                word &= rows[k][w];
+            return word;
+        }
+
+        /**
+         * @brief Number of original records among the candidates of a word.
+         */
+        int weigh(uint64_t word, const size_t& w) const {
+            if (weights.empty())
+                return __builtin_popcountll(word);
+            int matches = 0;
+            for (; word; word &= word - 1)
+                matches += weights[w * 64 + __builtin_ctzll(word)];
+            return matches;
+        }
+    public:
+        // Largest number of epsilon values, each one a bitset per feature and user
+        static constexpr size_t MAX_VALUES = 8;
+        // Words of a bitset from which skipping the words emptied by a wider epsilon pays off,
+        // smaller bitsets stay in cache and are cheaper to AND in full
+        static constexpr size_t NESTED_WORDS = 64;
+
+        /**
+         * @brief Construct a new multi-epsilon engine object.
+         *
+         * @param _dataset Global view of the dataset.
+         * @param _h_min Smallest background knowledge size.
+         * @param _h_max Largest background knowledge size.
+         * @param _values Epsilon values, at most MAX_VALUES.
+         * @param _kernel Kernel that fills the bitsets.
+         * @param _weights Number of original records represented by each record, empty if all are 1.
+         */
+        MultiEpsEngine(
+            std::vector<Record>& _dataset,
+            const short& _h_min,
+            const short& _h_max,
+            const std::vector<float>& _values,
+            bitset_kernel _kernel,
+            const std::vector<int>& _weights = {}
+        ): Engine(_dataset, _h_min, _h_max, _values[0], _weights), values(_values), order(_values.size()), data(_dataset), kernel(_kernel) {
+            std::iota(order.begin(), order.end(), 0);
+            auto positive = [this](size_t e) { return values[e] > 0 ? values[e] : 0.0f; };
+            std::stable_sort(order.begin(), order.end(), [&positive](size_t a, size_t b) { return positive(a) > positive(b); });
+        }
+
+        size_t width() const override {
+            return (h_max - h_min + 1) * values.size();
+        }
+
+        /**
+         * @brief Names of the risk columns, "Risk_eps0.1", ... for a single background knowledge
+         * size and "Risk_h1_eps0.1", ... for a sweep.
+         */
+        std::vector<std::string> columns() const override {
+            std::vector<std::string> names;
+            for (const std::string& name: risk_columns(h_min, h_max))
+                for (const float& value: values) {
+                    std::ostringstream stream;
+                    stream << name << "_eps" << value;
+                    names.push_back(stream.str());
+                }
+            return names;
+        }
+
+        float assess_risk(size_t i, short h) const override {
+            std::vector<float> risks(width());
+            assess_risks(i, risks.data());
+            return risks[(h - h_min) * values.size()];
+        }
+
+        void assess_risks(size_t i, float* risks) const override {
+            size_t n = data.size();
+            size_t m = data.features();
+            size_t count = values.size();
+            size_t words = (n + 63) / 64;
+            const float* u = dataset[i].features.data();
+            // Candidates matching the user on each feature with each epsilon, one bitset per pair
+            std::vector<uint64_t> bits(m * count * words);
+            for (size_t j = 0; j < m; j++)
+                for (size_t e = 0; e < count; e++)
+                    kernel(data.column(j), u[j], values[e], n, bits.data() + (j * count + e) * words);
+            // Rows of the features in the current combination
+            std::vector<const uint64_t*> rows;
+            // Words that can still hold a match of the combination, and those left by the current epsilon
+            std::vector<size_t> active(words), left;
+            std::iota(active.begin(), active.end(), 0);
+            bool nested = words >= NESTED_WORDS;
+            for (short h = h_min; h <= h_max; h++) {
+                // Minimum number of matches and single match found, for every epsilon
+                std::vector<int> min_matches(count, INT_MAX);
+                std::vector<bool> single(count, false);
+                // Number of epsilon values without a single match yet
+                size_t open = count;
+                CombinationsEnumerator comb(m, h);
+                do {
+                    for (size_t o = 0; o < count; o++) {
+                        size_t e = order[o];
+                        // Intervals of zero, negative or NaN epsilons are not nested in the others
+                        if (nested && (o == 0 || !(values[e] > 0))) {
+                            active.resize(words);
+                            std::iota(active.begin(), active.end(), 0);
+                        }
+                        if (single[e])
+                            continue;
+                        rows.clear();
+                        for (size_t j = 0; j < comb.mask.size(); j++)
+                            if (comb.mask[j])
+                                rows.push_back(bits.data() + (j * count + e) * words);
+                        // Number of matches for the combination
+                        int matches = 0;
+                        if (!nested)
+                            for (size_t w = 0; w < words; w++)
+                                matches += weigh(intersect(rows, w), w);
+                        else {
+                            left.clear();
+                            for (size_t w: active) {
+                                uint64_t word = intersect(rows, w);
+                                if (word) {
+                                    left.push_back(w);
+                                    matches += weigh(word, w);
+                                }
+                            }
+                            // Narrower epsilons match a subset of these candidates
+                            active.swap(left);
+                        }
+                        // If we have only 1 match the combination gives the risk
+                        if (matches == 1) {
+                            single[e] = true;
+                            open--;
+                        }
+                        // Else we take the minimum number of matches found
+                        else if (matches < min_matches[e])
+                            min_matches[e] = matches;
+                    }
+                } while (open > 0 && comb.next());
+                // Risk is the inverse of the minimum number of matches
+                for (size_t e = 0; e < count; e++)
+                    risks[(h - h_min) * count + e] = single[e] ? 1.0 : 1.0 / min_matches[e];
+            }
+        }
+    };
+} // namespace prudence
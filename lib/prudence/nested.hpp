@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <vector>
+
+#include <combinations.hpp>
+#include <prudence/engine.hpp>
+#include <prudence/pool.hpp>
+
+namespace prudence {
+    /**
+     * @brief Engine that splits the combinations of a single user among several threads, for
+     * datasets with fewer users than cores. The combinations are taken in blocks of consecutive
+     * ranks, each block starting from its unranked combination. The threads share the minimum
+     * number of matches found so far, used to stop counting a combination that can't lower it,
+     * and a flag that cancels the search as soon as one of them finds a single match.
+     * The threads are kept in a pool, started once for all the users and sizes.
+     */
+    class NestedEngine: public Engine {
+    private:
+        // Number of threads that share the combinations of a user
+        short threads;
+        // Threads of all the users assessed at the same time
+        mutable ComputePool pool;
+
+        /**
+         * @brief Counts the matches of u on the selected features, stopping at the bound.
+         */
+        int count_matches(const Record& u, const std::vector<size_t>& selected, const int& bound) const {
+            int matches = 0;
+            for (size_t v = 0; v < dataset.size() && matches < bound; v++) {
+                const std::vector<float>& values = dataset[v].features;
+                bool match = true;
+                for (size_t k = 0; k < selected.size() && match; k++) {
+                    size_t j = selected[k];
+                    float lo = values[j] - values[j] * eps;
+                    float hi = values[j] + values[j] * eps;
+                    match = !(u.features[j] < lo || u.features[j] > hi);
+                }
+                if (match)
+                    matches += weight(v);
+            }
+            return matches;
+        }
+    public:
+        /**
+         * @brief Construct a new nested engine object.
+         * 
+         * @param _dataset Global view of the dataset.
+         * @param _h_min Smallest background knowledge size.
+         * @param _h_max Largest background knowledge size.
+         * @param _eps Epsilon margin for the matching.
+         * @param _threads Number of threads that share the combinations of a user.
+         * @param callers Number of workers that assess users at the same time.
+         * @param _weights Number of original records represented by each record, empty if all are 1.
+         */
+        NestedEngine(
+            std::vector<Record>& _dataset,
+            const short& _h_min,
+            const short& _h_max,
+            const float& _eps,
+            const short& _threads,
+            const short& callers,
+            const std::vector<int>& _weights = {}
+        ): Engine(_dataset, _h_min, _h_max, _eps, _weights), threads(_threads), pool(_threads * std::max<short>(callers, 1)) {}
+
+        float assess_risk(size_t i, short h) const override {
+            Record& u = dataset[i];
+            int m = u.features.size();
+            // Combinations larger than the features fall back to the scan
+            if (h > m)
+                return prudence::assess_risk(u, dataset, h, eps, weights);
+            uint64_t total = CombinationsEnumerator::binomial(m, h);
+            // About 16 blocks per thread, so that the early exits don't unbalance them
+            uint64_t block = std::max<uint64_t>(1, total / (16 * (uint64_t) threads));
+            // Rank of the next block to compute
+            std::atomic<uint64_t> next{0};
+            // Minimum number of matches for a combination found so far
+            std::atomic<int> min_matches{INT_MAX};
+            // Set when a combination has a single match, the risk is then 1
+            std::atomic<bool> single{false};
+            auto work = [&]() {
+                std::vector<size_t> selected(h);
+                for (uint64_t start = next.fetch_add(block); start < total && !single.load(std::memory_order_relaxed); start = next.fetch_add(block)) {
+                    uint64_t stop = std::min(total, start + block);
+                    CombinationsEnumerator comb(m, h, start);
+                    for (uint64_t rank = start; rank < stop && !single.load(std::memory_order_relaxed); rank++, comb.next()) {
+                        for (int j = 0, k = 0; k < h; j++)
+                            if (comb.mask[j])
+                                selected[k++] = j;
+                        // Counting beyond this bound can neither give a single match nor a new minimum
+                        int bound = std::max(min_matches.load(std::memory_order_relaxed), 2);
+                        int matches = count_matches(u, selected, bound);
+                        if (matches >= bound)
+                            continue;
+                        if (matches == 1) {
+                            single.store(true, std::memory_order_relaxed);
+                            break;
+                        }
+                        int current = min_matches.load(std::memory_order_relaxed);
+                        while (matches < current && !min_matches.compare_exchange_weak(current, matches, std::memory_order_relaxed));
+                    }
+                }
+            };
+            pool.run(threads, [&](const size_t&) { work(); });
+            // Risk is the inverse of the minimum number of matches
+            return single ? 1.0 : 1.0 / min_matches;
+        }
+    };
+
+    /**
+     * @brief Number of threads per user that fills the cores when the users are fewer than the
+     * workers, 1 when there are enough users.
+     * 
+     * @param nw Number of workers.
+     * @param n Number of users.
+     */
+    inline short nested_threads(const short& nw, const size_t& n) {
+        if (nw <= 1 || n == 0 || n >= (size_t) nw)
+            return 1;
+        return (nw + n - 1) / n;
+    }
+} // namespace prudence
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace prudence {
+    /**
+     * @brief Command line options shared by all the executables.
+     */
+    struct Options {
+        // Number of workers to use
+        short nw = 0;
+        // Background knowledge size (the largest one in a sweep)
+        short h = 0;
+        // Smallest background knowledge size of a sweep, equal to h otherwise
+        short h_min = 0;
+        // Input file path
+        std::string input;
+        // Output file path
+        std::string output;
+        // Epsilon margin for the matching (the first one of a list)
+        float eps = 0.3;
+        // Epsilon margins computed in a single pass, given as a comma-separated list
+        std::vector<float> eps_values{ 0.3f };
+        // Index of the column representing the ID
+        int id_index = 0;
+        // Name of the engine that computes the risk
+        std::string engine = "scan";
+        // True if records with identical features are collapsed into weighted groups
+        bool dedup = false;
+        // Vector kernel of the SIMD and tiled engines
+        std::string simd = "auto";
+        // Largest chunk of users computed without splitting by the work stealing pool, 0 for automatic
+        size_t grain = 0;
+        // Queues between emitter and workers of the dynamic farm, "mutex" or "lockfree"
+        std::string queue = "mutex";
+        // Scheduling of the dynamic executables, "file" (fixed chunks in file order) or "cost"
+        // (guided chunks, most expensive users first)
+        std::string schedule = "file";
+        // Threads sharing the combinations of a user in the scan engine, 0 to choose them from
+        // the number of users and workers, -1 to disable the nested parallelism
+        short nested = 0;
+        // Prunings of the scan engine, "none", "bound" (bounded counting), "order" (selective
+        // combinations first) or "all"
+        std::string prune = "none";
+        // Memory budget of the streaming executable in MB
+        size_t memory = 1024;
+        // Index of the worker process that simulates a crash, -1 for none
+        int fail = -1;
+        // State file of the incremental mode
+        std::string state;
+        // True if the input holds the rows appended to the state, rather than a whole dataset
+        bool delta = false;
+        // CSV file with the rows to remove from the state
+        std::string remove;
+        // Only the users with a risk of at least this threshold are written, 0 to write every user
+        float threshold = 0;
+        // Only the k riskiest users are written, 0 to write every user
+        size_t top = 0;
+        // Bits of the codes of the quantized engine, 8 or 16, 0 for the smallest exact width
+        short bits = 0;
+        // True if the quantized and sampled engines compare every risk with the exact one
+        bool validate = false;
+        // Fraction of the candidates counted by the sampled engine, 0 for exact counts
+        float sample = 0;
+        // True if the sample is stratified on the most selective feature, rather than uniform
+        bool stratified = false;
+        // Fraction of the combinations evaluated by the sampled engine
+        float sample_combinations = 1;
+        // Seed of the sampled engine
+        unsigned long seed = 1;
+        // Seconds between two checkpoints of the finished users, 0 to disable them
+        double checkpoint = 0;
+        // True if the computation continues from the checkpoint next to the output
+        bool resume = false;
+    };
+
+    /**
+     * @brief Prints the usage string of the executable.
+     * 
+     * @param program Name of the executable.
+     */
+    inline void print_usage(const char* program) {
+        std::cerr << "Usage: " << program << " nw h|h_min:h_max input_filename output_filename [eps=0.3|eps1,eps2,...] [id_index=0]"
+                  << " [--engine=scan|bitset|apriori|simd|range|tiled|quantized|gray] [--simd=auto|avx512|avx2|scalar] [--dedup] [--grain=n] [--queue=mutex|lockfree] [--schedule=file|cost]"
+                  << " [--nested=auto|off|n] [--prune=none|bound|order|all] [--memory=MB] [--fail=k]"
+                  << " [--state=path] [--delta] [--remove=path] [--threshold=t] [--top=k] [--bits=auto|8|16] [--validate]"
+                  << " [--sample=f] [--stratified] [--sample-combinations=f] [--seed=n]"
+                  << " [--checkpoint=seconds] [--resume]" << std::endl;
+    }
+
+    /**
+     * @brief Parses the command line. Positional arguments are "nw h input output [eps] [id_index]",
+     * while flags in the form "--name=value" can appear anywhere.
+     * 
+     * @param argc Number of arguments.
+     * @param argv Values of the arguments.
+     * @param options Options to fill.
+     * @return true If the command line is valid.
+     * @return false Otherwise, after printing the reason and the usage.
+     */
+    inline bool parse_options(int argc, char const *argv[], Options& options) {
+        // Number of positional arguments found so far
+        int positional = 0;
+        for (int i = 1; i < argc; i++) {
+            std::string arg(argv[i]);
+            if (arg.rfind("--", 0) == 0) {
+                // Splits the flag into name and value
+                size_t equal = arg.find('=');
+                std::string name = arg.substr(2, equal == std::string::npos ? std::string::npos : equal - 2);
+                std::string value = (equal == std::string::npos) ? "" : arg.substr(equal + 1);
+                if (name == "engine")
+                    options.engine = value;
+                else if (name == "simd")
+                    options.simd = value;
+                else if (name == "dedup")
+                    options.dedup = true;
+                else if (name == "grain")
+                    options.grain = strtoul(value.c_str(), NULL, 10);
+                else if (name == "queue" && (value == "mutex" || value == "lockfree"))
+                    options.queue = value;
+                else if (name == "schedule" && (value == "file" || value == "cost"))
+                    options.schedule = value;
+                else if (name == "prune" && (value == "none" || value == "bound" || value == "order" || value == "all"))
+                    options.prune = value;
+                else if (name == "memory" && strtoul(value.c_str(), NULL, 10) > 0)
+                    options.memory = strtoul(value.c_str(), NULL, 10);
+                else if (name == "state")
+                    options.state = value;
+                else if (name == "delta")
+                    options.delta = true;
+                else if (name == "remove")
+                    options.remove = value;
+                else if (name == "threshold" && strtof(value.c_str(), NULL) > 0 && strtof(value.c_str(), NULL) <= 1)
+                    options.threshold = strtof(value.c_str(), NULL);
+                else if (name == "top" && strtoul(value.c_str(), NULL, 10) > 0)
+                    options.top = strtoul(value.c_str(), NULL, 10);
+                else if (name == "bits" && (value == "auto" || value == "8" || value == "16"))
+                    options.bits = (value == "auto") ? 0 : (short) strtol(value.c_str(), NULL, 10);
+                else if (name == "validate")
+                    options.validate = true;
+                else if (name == "sample" && strtof(value.c_str(), NULL) > 0 && strtof(value.c_str(), NULL) <= 1)
+                    options.sample = strtof(value.c_str(), NULL);
+                else if (name == "stratified")
+                    options.stratified = true;
+                else if (name == "sample-combinations" && strtof(value.c_str(), NULL) > 0 && strtof(value.c_str(), NULL) <= 1)
+                    options.sample_combinations = strtof(value.c_str(), NULL);
+                else if (name == "seed")
+                    options.seed = strtoul(value.c_str(), NULL, 10);
+                else if (name == "checkpoint" && strtod(value.c_str(), NULL) > 0)
+                    options.checkpoint = strtod(value.c_str(), NULL);
+                else if (name == "resume")
+                    options.resume = true;
+                else if (name == "fail")
+                    options.fail = strtol(value.c_str(), NULL, 10);
+                else if (name == "nested" && (value == "auto" || value == "off" || strtol(value.c_str(), NULL, 10) > 0))
+                    options.nested = (value == "auto") ? 0 : (value == "off") ? -1 : (short) strtol(value.c_str(), NULL, 10);
+                else {
+                    std::cerr << argv[0] << ": unknown flag " << arg << std::endl;
+                    print_usage(argv[0]);
+                    return false;
+                }
+                continue;
+            }
+            switch (positional++) {
+                case 0: options.nw = (short) strtol(argv[i], NULL, 10); break;
+                case 1: {
+                    // Either a single size "h" or a sweep "h_min:h_max"
+                    char* end;
+                    options.h_min = options.h = (short) strtol(argv[i], &end, 10);
+                    if (*end == ':')
+                        options.h = (short) strtol(end + 1, NULL, 10);
+                    break;
+                }
+                case 2: options.input = arg; break;
+                case 3: options.output = arg; break;
+                case 4: {
+                    // Either a single epsilon or a comma-separated list
+                    options.eps_values.clear();
+                    std::stringstream values(arg);
+                    for (std::string value; std::getline(values, value, ',');)
+                        options.eps_values.push_back(strtof(value.c_str(), NULL));
+                    if (options.eps_values.empty())
+                        options.eps_values.push_back(0);
+                    options.eps = options.eps_values[0];
+                    break;
+                }
+                case 5: options.id_index = strtol(argv[i], NULL, 10); break;
+                default:
+                    std::cerr << argv[0] << ": unexpected argument " << arg << std::endl;
+                    print_usage(argv[0]);
+                    return false;
+            }
+        }
+        // Checks the CLI parameters size
+        if (positional < 4) {
+            print_usage(argv[0]);
+            return false;
+        }
+        if (options.h_min < 1 || options.h < options.h_min) {
+            std::cerr << argv[0] << ": invalid background knowledge size " << options.h_min << ":" << options.h << std::endl;
+            return false;
+        }
+        return true;
+    }
+} // namespace prudence
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <safe_queue.hpp>
+
+namespace prudence {
+    /**
+     * @brief Fixed pool of threads that runs batches of tasks, so that repeated parallel steps
+     * don't start new threads. The daemon runs the computations of every connection on it, so
+     * the number of concurrent computations stays nw however many clients are connected.
+     */
+    class ComputePool {
+    private:
+        // Tasks to run, an empty task stops a thread
+        SafeQueue<std::function<void()>> tasks;
+        // Threads of the pool
+        std::vector<std::thread> threads;
+    public:
+        /**
+         * @brief Construct a new compute pool object.
+         *
+         * @param nw Number of threads.
+         */
+        ComputePool(const short& nw) {
+            for (short w = 0; w < nw; w++)
+                threads.emplace_back([this]() {
+                    for (std::function<void()> task = tasks.pop(); task; task = tasks.pop())
+                        task();
+                });
+        }
+
+        /**
+         * @brief Stops the threads after the tasks already submitted.
+         */
+        ~ComputePool() {
+            for (size_t w = 0; w < threads.size(); w++)
+                tasks.push(nullptr);
+            for (std::thread& t: threads)
+                t.join();
+        }
+
+        /**
+         * @brief Number of threads.
+         */
+        size_t size() const {
+            return threads.size();
+        }
+
+        /**
+         * @brief Runs count tasks on the pool and waits for all of them.
+         *
+         * @param count Number of tasks.
+         * @param task Function called with the index of each task.
+         */
+        void run(const size_t& count, const std::function<void(size_t)>& task) {
+            std::mutex mutex;
+            std::condition_variable done;
+            size_t remaining = count;
+            for (size_t t = 0; t < count; t++)
+                tasks.push([&, t]() {
+                    task(t);
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (--remaining == 0)
+                        done.notify_one();
+                });
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [&]() { return remaining == 0; });
+        }
+    };
+} // namespace prudence
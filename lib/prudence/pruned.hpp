@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <climits>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <combinations.hpp>
+#include <prudence/columnar.hpp>
+#include <prudence/engine.hpp>
+#include <prudence/range.hpp>
+
+namespace prudence {
+    /**
+     * @brief Orders the features from the most to the least selective, estimating the selectivity
+     * of a feature as the average number of candidates matching a user on it alone.
+     * 
+     * @param dataset Global view of the dataset.
+     * @param eps Epsilon margin for the matching.
+     * @return std::vector<size_t> Indices of the features, the most selective first.
+     */
+    inline std::vector<size_t> selectivity_order(const std::vector<Record>& dataset, const float& eps) {
+        size_t m = dataset.empty() ? 0 : dataset[0].features.size();
+        std::vector<size_t> order(m);
+        std::iota(order.begin(), order.end(), 0);
+        if (m == 0)
+            return order;
+        ColumnarDataset columns(dataset);
+        RangeIndex index(columns, eps);
+        std::vector<double> selectivity(m, 0);
+        for (size_t j = 0; j < m; j++)
+            for (size_t i = 0; i < columns.size(); i++)
+                selectivity[j] += index.range(j, columns.at(i, j)).size();
+        std::stable_sort(order.begin(), order.end(), [&selectivity](const size_t& a, const size_t& b) {
+            return selectivity[a] < selectivity[b];
+        });
+        return order;
+    }
+
+    /**
+     * @brief Counters of the engines that bound their counts: combinations counted and candidates
+     * checked, updated by every thread.
+     */
+    struct PruningCounters {
+        // Number of combinations counted
+        std::atomic<size_t> combinations{0};
+        // Number of candidates checked
+        std::atomic<size_t> checked{0};
+
+        /**
+         * @brief Adds the counters of a user.
+         */
+        void add(const size_t& counted, const size_t& visited) {
+            combinations.fetch_add(counted, std::memory_order_relaxed);
+            checked.fetch_add(visited, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Combinations counted, candidate checks performed out of the ones of an unbounded
+         * count, and the fraction skipped.
+         * 
+         * @param n Number of candidates of an unbounded count.
+         */
+        std::string report(const size_t& n) const {
+            size_t performed = checked.load(), full = combinations.load() * n;
+            std::ostringstream stream;
+            stream << " Combinations: " << combinations.load() << " Checks: " << performed << "/" << full
+                   << " Skipped: " << (full ? 100.0 * (full - performed) / full : 0.0) << "%";
+            return stream.str();
+        }
+    };
+
+    /**
+     * @brief Scan engine with two prunings, that can be enabled separately:
+     * - bounded counting: the count of a combination stops as soon as it reaches the minimum
+     *   found so far (or 2), since it can neither lower the risk nor give a single match;
+     * - selectivity ordering: the features are relabeled from the most to the least selective,
+     *   estimated once on the sorted columns, so that the combinations of selective features,
+     *   likely to have few matches, come first and lower the bound early.
+     * The engine counts the combinations and the candidate checks it performs.
+     */
+    class PrunedScanEngine: public Engine {
+    private:
+        // True if the counts stop at the bound
+        bool bounded;
+        // Features in the order of enumeration
+        std::vector<size_t> order;
+        // Combinations counted and candidates checked
+        mutable PruningCounters counters;
+
+        /**
+         * @brief Walks the combinations of exactly H features, relabeled by the order.
+         */
+        template <size_t H>
+        float assess_risk_fixed(const Record& u, size_t& counted, size_t& visited) const {
+            int min_matches = INT_MAX;
+            FixedCombinationsEnumerator<H> comb(u.features.size());
+            std::array<uint8_t, H> selected;
+            do {
+                for (size_t k = 0; k < H; k++)
+                    selected[k] = order[comb.indices[k]];
+                counted++;
+                int bound = bounded ? std::max(min_matches, 2) : INT_MAX;
+                int matches = matches_combination<H>(u, dataset, eps, selected, weights, bound, &visited);
+                if (matches == 1)
+                    return 1.0;
+                if (matches < min_matches)
+                    min_matches = matches;
+            } while (comb.next());
+            return 1.0 / min_matches;
+        }
+
+        /**
+         * @brief Walks the combinations of any size, relabeled by the order.
+         */
+        float assess_risk_generic(Record& u, const short& h, size_t& counted, size_t& visited) const {
+            int min_matches = INT_MAX;
+            CombinationsEnumerator comb(u.features.size(), h);
+            std::vector<bool> mask(u.features.size());
+            do {
+                for (size_t j = 0; j < comb.mask.size(); j++)
+                    mask[order[j]] = comb.mask[j];
+                counted++;
+                int bound = bounded ? std::max(min_matches, 2) : INT_MAX;
+                int matches = matches_combination(u, dataset, eps, mask, weights, bound, &visited);
+                if (matches == 1)
+                    return 1.0;
+                if (matches < min_matches)
+                    min_matches = matches;
+            } while (comb.next());
+            return 1.0 / min_matches;
+        }
+    public:
+        /**
+         * @brief Construct a new pruned scan engine object.
+         * 
+         * @param _dataset Global view of the dataset.
+         * @param _h_min Smallest background knowledge size.
+         * @param _h_max Largest background knowledge size.
+         * @param _eps Epsilon margin for the matching.
+         * @param _bounded True if the counts stop at the minimum found so far.
+         * @param ordered True if the combinations of the most selective features come first.
+         * @param _weights Number of original records represented by each record, empty if all are 1.
+         */
+        PrunedScanEngine(
+            std::vector<Record>& _dataset,
+            const short& _h_min,
+            const short& _h_max,
+            const float& _eps,
+            const bool& _bounded,
+            const bool& ordered,
+            const std::vector<int>& _weights = {}
+        ): Engine(_dataset, _h_min, _h_max, _eps, _weights), bounded(_bounded) {
+            if (ordered)
+                order = selectivity_order(_dataset, _eps);
+            else {
+                order.resize(_dataset.empty() ? 0 : _dataset[0].features.size());
+                std::iota(order.begin(), order.end(), 0);
+            }
+        }
+
+        float assess_risk(size_t i, short h) const override {
+            Record& u = dataset[i];
+            size_t counted = 0, visited = 0;
+            // Dispatches the common sizes to the specialized path
+            float risk = dispatch_fixed(h, u.features.size(), [&](auto H) {
+                return assess_risk_fixed<decltype(H)::value>(u, counted, visited);
+            }, [&]() {
+                return assess_risk_generic(u, h, counted, visited);
+            });
+            counters.add(counted, visited);
+            return risk;
+        }
+
+        /**
+         * @brief Work saved by the prunings.
+         */
+        std::string report() const override {
+            return counters.report(dataset.size());
+        }
+    };
+} // namespace prudence
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <combinations.hpp>
+#include <prudence/engine.hpp>
+
+namespace prudence {
+    /**
+     * @brief Order-preserving integer codes of the features, computed once for a given eps.
+     * On each feature the user values and the matching bounds [v - v * eps, v + v * eps] of
+     * every candidate are sorted together and replaced by their rank, so that u < lo and u > hi
+     * compare the same on the codes. When a feature has more distinct values than codes, ranks
+     * are merged: the codes stay monotone, so a match is never lost, but some pairs that don't
+     * match on the floats can match on the codes.
+     */
+    struct Quantization {
+        // Bits of a code, 8 or 16
+        short bits = 16;
+        // True if every feature has a code per distinct value
+        bool exact = true;
+        // Sorted distinct values of each feature
+        std::vector<std::vector<float>> values;
+
+        /**
+         * @brief Number of codes for the values, excluding the two reserved for missing bounds.
+         */
+        size_t levels() const {
+            return (size_t(1) << bits) - 2;
+        }
+
+        /**
+         * @brief Code of a value of feature j, from 1 to levels().
+         */
+        uint32_t code(const size_t& j, const float& x) const {
+            const std::vector<float>& sorted = values[j];
+            size_t rank = std::lower_bound(sorted.begin(), sorted.end(), x) - sorted.begin();
+            if (sorted.size() <= levels())
+                return 1 + rank;
+            return 1 + rank * levels() / sorted.size();
+        }
+
+        /**
+         * @brief Code of a lower bound, 0 if it is NaN since no value is below it.
+         */
+        uint32_t lower(const size_t& j, const float& lo) const {
+            return std::isnan(lo) ? 0 : code(j, lo);
+        }
+
+        /**
+         * @brief Code of an upper bound, the largest one if it is NaN since no value is above it.
+         */
+        uint32_t upper(const size_t& j, const float& hi) const {
+            return std::isnan(hi) ? levels() + 1 : code(j, hi);
+        }
+    };
+
+    /**
+     * @brief Collects the values of the features and picks the width of the codes.
+     *
+     * @param dataset Global view of the dataset.
+     * @param eps Epsilon margin for the matching.
+     * @param bits Bits of a code, 8 or 16, or 0 for the smallest exact width (16 if none is).
+     * @return Quantization The codes of the features.
+     */
+    inline Quantization quantize(const std::vector<Record>& dataset, const float& eps, const short& bits) {
+        Quantization quantization;
+        size_t m = dataset.empty() ? 0 : dataset[0].features.size();
+        quantization.values.resize(m);
+        size_t distinct = 0;
+        for (size_t j = 0; j < m; j++) {
+            std::vector<float>& sorted = quantization.values[j];
+            for (const Record& v: dataset) {
+                float value = v.features[j];
+                float lo = value - value * eps;
+                float hi = value + value * eps;
+                for (float x: { value, lo, hi })
+                    if (!std::isnan(x))
+                        sorted.push_back(x);
+            }
+            std::sort(sorted.begin(), sorted.end());
+            sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+            distinct = std::max(distinct, sorted.size());
+        }
+        quantization.bits = bits ? bits : (distinct <= 254) ? 8 : 16;
+        quantization.exact = distinct <= quantization.levels();
+        return quantization;
+    }
+
+    /**
+     * @brief Counts the candidates whose bounds contain the user codes on every selected
+     * feature. Blocks of candidates are filtered one feature at a time, so that the loops
+     * compile to wide integer comparisons.
+     */
+    template <typename T>
+    __attribute__((always_inline))
+    inline int count_codes_body(const T* const* lo, const T* const* hi, const T* codes, const short& h, const int* weights, const size_t& n) {
+        constexpr size_t BLOCK = 512;
+        alignas(64) uint8_t flags[BLOCK];
+        int matches = 0;
+        for (size_t begin = 0; begin < n; begin += BLOCK) {
+            size_t length = std::min(BLOCK, n - begin);
+            for (size_t v = 0; v < length; v++)
+                flags[v] = 1;
+            for (short k = 0; k < h; k++) {
+                const T* l = lo[k] + begin;
+                const T* u = hi[k] + begin;
+                T c = codes[k];
+                for (size_t v = 0; v < length; v++)
+                    flags[v] &= (l[v] <= c) & (c <= u[v]);
+            }
+            if (weights) {
+                for (size_t v = 0; v < length; v++)
+                    matches += flags[v] * weights[begin + v];
+            }
+            else {
+                for (size_t v = 0; v < length; v++)
+                    matches += flags[v];
+            }
+        }
+        return matches;
+    }
+
+    /**
+     * @brief Counting kernel on the codes.
+     */
+    template <typename T>
+    using code_kernel = int (*)(const T* const*, const T* const*, const T*, const short&, const int*, const size_t&);
+
+    template <typename T>
+    inline int count_codes_scalar(const T* const* lo, const T* const* hi, const T* codes, const short& h, const int* weights, const size_t& n) {
+        return count_codes_body(lo, hi, codes, h, weights, n);
+    }
+
+    template <typename T>
+    __attribute__((target("avx2")))
+    inline int count_codes_avx2(const T* const* lo, const T* const* hi, const T* codes, const short& h, const int* weights, const size_t& n) {
+        return count_codes_body(lo, hi, codes, h, weights, n);
+    }
+
+    template <typename T>
+    __attribute__((target("avx512f,avx512bw")))
+    inline int count_codes_avx512(const T* const* lo, const T* const* hi, const T* codes, const short& h, const int* weights, const size_t& n) {
+        return count_codes_body(lo, hi, codes, h, weights, n);
+    }
+
+    /**
+     * @brief Selects the widest code kernel supported by the CPU.
+     *
+     * @param name One of "auto", "avx512", "avx2" and "scalar".
+     * @return code_kernel<T> The kernel, or nullptr if the name is unknown or not supported.
+     */
+    template <typename T>
+    inline code_kernel<T> select_code_kernel(const std::string& name) {
+        __builtin_cpu_init();
+        bool avx512 = __builtin_cpu_supports("avx512bw");
+        bool avx2 = __builtin_cpu_supports("avx2");
+        if (name == "avx512" || (name == "auto" && avx512))
+            return avx512 ? count_codes_avx512<T> : nullptr;
+        if (name == "avx2" || (name == "auto" && avx2))
+            return avx2 ? count_codes_avx2<T> : nullptr;
+        if (name == "scalar" || name == "auto")
+            return count_codes_scalar<T>;
+        return nullptr;
+    }
+
+    /**
+     * @brief Engine that matches on the integer codes of a quantization: every candidate keeps
+     * the codes of its bounds, every user the codes of its values, and the match becomes two
+     * integer comparisons on T-sized columns. In validation mode every risk is also computed on
+     * the floats, and the differences are counted and the first ones printed.
+     *
+     * @tparam T Type of a code, uint8_t or uint16_t.
+     */
+    template <typename T>
+    class QuantizedEngine: public Engine {
+    private:
+        // Codes of the quantization
+        Quantization quantization;
+        // Kernel that counts the matches
+        code_kernel<T> kernel;
+        // Codes of the lower bounds, one column per feature
+        std::vector<std::vector<T>> lower;
+        // Codes of the upper bounds, one column per feature
+        std::vector<std::vector<T>> upper;
+        // Codes of the values of the users, one row per user
+        std::vector<T> codes;
+        // True for the missing values of the users, that match every candidate
+        std::vector<bool> missing;
+        // True if the risks are compared with the float path
+        bool validate;
+        // Number of risks that differ from the float path
+        mutable std::atomic<size_t> mismatches{0};
+        // Guards the printing of the mismatches
+        mutable std::mutex print_mutex;
+    public:
+        /**
+         * @brief Construct a new quantized engine object.
+         *
+         * @param _dataset Global view of the dataset.
+         * @param _h_min Smallest background knowledge size.
+         * @param _h_max Largest background knowledge size.
+         * @param _eps Epsilon margin for the matching.
+         * @param _quantization Codes of the features, with sizeof(T) * 8 bits.
+         * @param _kernel Kernel that counts the matches.
+         * @param _validate True if the risks are compared with the float path.
+         * @param _weights Number of original records represented by each record, empty if all are 1.
+         */
+        QuantizedEngine(
+            std::vector<Record>& _dataset,
+            const short& _h_min,
+            const short& _h_max,
+            const float& _eps,
+            Quantization&& _quantization,
+            code_kernel<T> _kernel,
+            const bool& _validate,
+            const std::vector<int>& _weights = {}
+        ): Engine(_dataset, _h_min, _h_max, _eps, _weights), quantization(std::move(_quantization)), kernel(_kernel), validate(_validate) {
+            size_t n = _dataset.size();
+            size_t m = quantization.values.size();
+            lower.assign(m, std::vector<T>(n));
+            upper.assign(m, std::vector<T>(n));
+            codes.resize(n * m);
+            missing.resize(n * m);
+            for (size_t v = 0; v < n; v++)
+                for (size_t j = 0; j < m; j++) {
+                    float value = _dataset[v].features[j];
+                    // Same bounds of Record::matches
+                    lower[j][v] = quantization.lower(j, value - value * _eps);
+                    upper[j][v] = quantization.upper(j, value + value * _eps);
+                    missing[v * m + j] = std::isnan(value);
+                    codes[v * m + j] = missing[v * m + j] ? 0 : quantization.code(j, value);
+                }
+        }
+
+        float assess_risk(size_t i, short h) const override {
+            size_t m = quantization.values.size();
+            // Columns and user codes of the features in the current combination
+            std::vector<const T*> lo(h), hi(h);
+            std::vector<T> selected(h);
+            // Minimum number of matches for a combination
+            int min_matches = INT_MAX;
+            float risk = 0;
+            CombinationsEnumerator comb(m, h);
+            do {
+                short k = 0;
+                for (size_t j = 0; j < comb.mask.size(); j++)
+                    // A missing value of the user matches every candidate, so its feature is skipped
+                    if (comb.mask[j] && !missing[i * m + j]) {
+                        lo[k] = lower[j].data();
+                        hi[k] = upper[j].data();
+                        selected[k++] = codes[i * m + j];
+                    }
+                // Number of matches for the combination
+                int matches = kernel(lo.data(), hi.data(), selected.data(), k, weights.empty() ? nullptr : weights.data(), dataset.size());
+                // If we have only 1 match the combination gives the risk
+                if (matches == 1) {
+                    risk = 1.0;
+                    break;
+                }
+                // Else we take the minimum number of matches found
+                if (matches < min_matches)
+                    min_matches = matches;
+            } while (comb.next());
+            // Risk is the inverse of the minimum number of matches
+            if (risk == 0)
+                risk = 1.0 / min_matches;
+            if (validate) {
+                float expected = prudence::assess_risk(dataset[i], dataset, h, eps, weights);
+                if (expected != risk && !(std::isnan(expected) && std::isnan(risk)) && mismatches++ < 10) {
+                    std::unique_lock<std::mutex> lock(print_mutex);
+                    std::cerr << "Mismatch: " << dataset[i].id << " h=" << h << " float " << expected << " quantized " << risk << std::endl;
+                }
+            }
+            return risk;
+        }
+
+        /**
+         * @brief Width and exactness of the codes, and the mismatches found in validation mode.
+         */
+        std::string report() const override {
+            std::ostringstream stream;
+            stream << " Bits: " << quantization.bits << " Exact: " << (quantization.exact ? "yes" : "no");
+            if (validate)
+                stream << " Mismatches: " << mismatches.load();
+            return stream.str();
+        }
+    };
+} // namespace prudence
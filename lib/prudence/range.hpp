@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include <prudence/columnar.hpp>
+#include <prudence/engine.hpp>
+
+namespace prudence {
+    /**
+     * @brief Index holding every feature column sorted, with the record IDs attached.
+     * Since a candidate v matches u on feature j if u_j is in [v_j - eps * v_j, v_j + eps * v_j],
+     * the candidates matching u on j form a contiguous range of the sorted column.
+     */
+    class RangeIndex {
+    private:
+        // Number of records
+        size_t n;
+        // Epsilon margin for the matching
+        float eps;
+        // Relative slack that makes the ranges conservative w.r.t. float rounding
+        double slack;
+        // Sorted values of each feature
+        std::vector<std::vector<float>> values;
+        // Index of the record of each sorted value
+        std::vector<std::vector<size_t>> records;
+        // True if the feature can be searched (finite values and eps in [0, 1))
+        std::vector<bool> searchable;
+    public:
+        /**
+         * @brief A range of positions in a sorted column.
+         */
+        struct Range {
+            size_t begin;
+            size_t end;
+
+            size_t size() const { return end - begin; }
+        };
+
+        /**
+         * @brief Construct a new range index object.
+         * 
+         * @param columns Columnar view of the dataset.
+         * @param _eps Epsilon margin for the matching.
+         */
+        RangeIndex(const ColumnarDataset& columns, const float& _eps):
+            n(columns.size()), eps(_eps), slack(1e-5 / (1.0 - _eps)),
+            values(columns.features()), records(columns.features()), searchable(columns.features()) {
+            for (size_t j = 0; j < columns.features(); j++) {
+                const float* column = columns.column(j);
+                // Sorts the record indices by value
+                records[j].resize(n);
+                std::iota(records[j].begin(), records[j].end(), 0);
+                std::stable_sort(records[j].begin(), records[j].end(), [column](const size_t& a, const size_t& b) {
+                    return column[a] < column[b];
+                });
+                values[j].resize(n);
+                bool finite = eps >= 0 && eps < 1;
+                for (size_t k = 0; k < n; k++) {
+                    values[j][k] = column[records[j][k]];
+                    finite = finite && std::isfinite(values[j][k]);
+                }
+                searchable[j] = finite;
+            }
+        }
+
+        /**
+         * @brief Finds the positions of the candidates that can match a value on a feature.
+         * The range may contain a few non-matching candidates, never miss a matching one.
+         * 
+         * @param j Index of the feature.
+         * @param x Value of the user on the feature.
+         * @return Range Positions in the sorted column.
+         */
+        Range range(const size_t& j, const float& x) const {
+            // NaN matches everything, while the index only handles finite values
+            if (!searchable[j] || std::isnan(x))
+                return { 0, n };
+            const std::vector<float>& column = values[j];
+            // Negative values only match themselves, and only with a null epsilon
+            if (x < 0) {
+                if (eps > 0)
+                    return { 0, 0 };
+                auto equal = std::equal_range(column.begin(), column.end(), x);
+                return { size_t(equal.first - column.begin()), size_t(equal.second - column.begin()) };
+            }
+            // Bounds of v such that v / (1 + eps) <= x <= v / (1 - eps), widened by the slack
+            double lo = (double) x / (1.0 + eps) * (1.0 - slack);
+            double hi = (double) x / (1.0 - eps) * (1.0 + slack) + 2 * (double) FLT_MIN;
+            size_t begin = std::lower_bound(column.begin(), column.end(), lo, [](const float& value, const double& bound) {
+                return value < bound;
+            }) - column.begin();
+            size_t end = std::upper_bound(column.begin() + begin, column.end(), hi, [](const double& bound, const float& value) {
+                return bound < value;
+            }) - column.begin();
+            return { begin, end };
+        }
+
+        /**
+         * @brief Index of the record at a position of a sorted column.
+         */
+        size_t record(const size_t& j, const size_t& position) const {
+            return records[j][position];
+        }
+    };
+
+    /**
+     * @brief Engine that, for every combination, checks only the candidates in the range of
+     * the most selective feature, found by binary search on the range index.
+     */
+    class RangeEngine: public Engine {
+    private:
+        // Columnar copy of the dataset
+        ColumnarDataset columns;
+        // Sorted columns
+        RangeIndex index;
+
+        /**
+         * @brief Checks if u matches v on the selected features, with the same bounds of Record::matches.
+         */
+        bool matches(const float* u, const size_t& v, const std::vector<size_t>& selected) const {
+            for (size_t j: selected) {
+                float value = columns.at(v, j);
+                float lo = value - value * eps;
+                float hi = value + value * eps;
+                if (u[j] < lo || u[j] > hi)
+                    return false;
+            }
+            return true;
+        }
+    public:
+        /**
+         * @brief Construct a new range engine object.
+         * 
+         * @param _dataset Global view of the dataset.
+         * @param _h_min Smallest background knowledge size.
+         * @param _h_max Largest background knowledge size.
+         * @param _eps Epsilon margin for the matching.
+         * @param _weights Number of original records represented by each record, empty if all are 1.
+         */
+        RangeEngine(
+            std::vector<Record>& _dataset,
+            const short& _h_min,
+            const short& _h_max,
+            const float& _eps,
+            const std::vector<int>& _weights = {}
+        ): Engine(_dataset, _h_min, _h_max, _eps, _weights), columns(_dataset), index(columns, _eps) {}
+
+        float assess_risk(size_t i, short h) const override {
+            const float* u = dataset[i].features.data();
+            size_t m = columns.features();
+            // Range of candidates of every feature
+            std::vector<RangeIndex::Range> ranges(m);
+            for (size_t j = 0; j < m; j++)
+                ranges[j] = index.range(j, u[j]);
+            // Indices of the features in the current combination
+            std::vector<size_t> selected(h);
+            // Minimum number of matches for a combination
+            int min_matches = INT_MAX;
+            CombinationsEnumerator comb(m, h);
+            do {
+                // Most selective feature of the combination
+                size_t best = m;
+                for (size_t j = 0, k = 0; j < comb.mask.size(); j++)
+                    if (comb.mask[j]) {
+                        selected[k++] = j;
+                        if (best == m || ranges[j].size() < ranges[best].size())
+                            best = j;
+                    }
+                // Number of matches for the combination
+                int matches = 0;
+                for (size_t p = ranges[best].begin; p < ranges[best].end; p++) {
+                    size_t v = index.record(best, p);
+                    if (this->matches(u, v, selected))
+                        matches += weight(v);
+                }
+                // If we have only 1 match the combination gives the risk
+                if (matches == 1)
+                    return 1.0;
+                // Else we take the minimum number of matches found
+                if (matches < min_matches)
+                    min_matches = matches;
+            } while (comb.next());
+            // Risk is the inverse of the minimum number of matches
+            return 1.0 / min_matches;
+        }
+    };
+} // namespace prudence
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -17,6 +19,11 @@ namespace prudence {
         // Vector of features
         std::vector<float> features;
 
+        /**
+         * @brief Construct an empty record object, to be filled by a loader.
+         */
+        Record() {}
+
         /**
          * @brief Construct a new record object
          * 
@@ -53,7 +60,7 @@ namespace prudence {
          * @return true If all the selected indices match.
          * @return false Otherwise.
          */
-        bool matches(const Record& v, const float& eps, std::vector<bool> mask) {
+        bool matches(const Record& v, const float& eps, const std::vector<bool>& mask) const {
             for (size_t j = 0; j < mask.size(); j++)
                 if (mask[j]) {
                     float lo = v.features[j] - v.features[j] * eps;
@@ -63,5 +70,27 @@ namespace prudence {
                 }
             return true;
         }
+
+        /**
+         * @brief Matches a record against another on exactly H features.
+         * 
+         * @tparam H Number of features accountable to the match.
+         * @param v Other record to match
+         * @param eps Epsilon margin of the computation
+         * @param selected Indices of the features accountable to the match.
+         * @return true If all the selected indices match.
+         * @return false Otherwise.
+         */
+        template <size_t H>
+        bool matches(const Record& v, const float& eps, const std::array<uint8_t, H>& selected) const {
+            for (size_t k = 0; k < H; k++) {
+                size_t j = selected[k];
+                float lo = v.features[j] - v.features[j] * eps;
+                float hi = v.features[j] + v.features[j] * eps;
+                if (this->features[j] < lo || this->features[j] > hi)
+                    return false;
+            }
+            return true;
+        }
     };
 } // namespace prudence
\ No newline at end of file
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <combinations.hpp>
+#include <prudence/columnar.hpp>
+#include <prudence/engine.hpp>
+#include <prudence/pruned.hpp>
+#include <prudence/simd.hpp>
+
+namespace prudence {
+    /**
+     * @brief Draws the candidates of a sample, in dataset order.
+     * - uniform: a random subset of ceil(fraction * n) candidates;
+     * - stratified: the candidates are sorted by their value on the most selective feature and
+     *   every (1 / fraction)-th one is taken from a random offset, so that every range of that
+     *   feature is represented in proportion.
+     *
+     * @param dataset Global view of the dataset.
+     * @param eps Epsilon margin for the matching, to rank the features.
+     * @param fraction Fraction of the candidates to draw, in (0, 1].
+     * @param stratified True for the stratified sample.
+     * @param seed Seed of the generator, so that the same options give the same sample.
+     * @return std::vector<size_t> Indices of the sampled candidates, sorted.
+     */
+    inline std::vector<size_t> sample_candidates(
+        const std::vector<Record>& dataset,
+        const float& eps,
+        const float& fraction,
+        const bool& stratified,
+        const uint64_t& seed
+    ) {
+        size_t n = dataset.size();
+        size_t s = std::min<size_t>(n, std::ceil(fraction * n));
+        std::mt19937_64 generator(seed);
+        std::vector<size_t> indices(n);
+        std::iota(indices.begin(), indices.end(), 0);
+        std::vector<size_t> sample;
+        if (s == 0)
+            return sample;
+        if (stratified && !dataset[0].features.empty()) {
+            size_t j = selectivity_order(dataset, eps)[0];
+            std::stable_sort(indices.begin(), indices.end(), [&dataset, &j](const size_t& a, const size_t& b) {
+                return dataset[a].features[j] < dataset[b].features[j];
+            });
+            // Systematic draw over the sorted candidates
+            double step = (double) n / s;
+            double offset = std::uniform_real_distribution<double>(0, step)(generator);
+            for (size_t k = 0; k < s; k++)
+                sample.push_back(indices[std::min<size_t>(n - 1, offset + k * step)]);
+        }
+        else {
+            // Partial Fisher-Yates shuffle of the first s indices
+            for (size_t k = 0; k < s; k++)
+                std::swap(indices[k], indices[std::uniform_int_distribution<size_t>(k, n - 1)(generator)]);
+            sample.assign(indices.begin(), indices.begin() + s);
+        }
+        std::sort(sample.begin(), sample.end());
+        return sample;
+    }
+
+    /**
+     * @brief Engine that estimates the number of matches of a combination from a sample of the
+     * candidates, scaled to the dataset. A count with few sampled matches is estimated poorly,
+     * and decides the risk when it is the smallest, so it is recomputed exactly on the whole
+     * dataset: single matches and small counts stay exact. Optionally only a fraction of the
+     * combinations is evaluated, which can only miss smaller counts.
+     * Every risk comes with a 95% interval, from the Wilson interval of the sampled proportion
+     * of each estimated count (exact counts have no width). The interval of a user holds if the
+     * ones of its counts hold; with sampled combinations its upper end is at least 1.
+     * The risks of a user are stored size by size, as estimate, lower and upper end.
+     * In validation mode every risk is also computed exactly, to measure error and speedup.
+     */
+    class SampledEngine: public Engine {
+    private:
+        // Columnar copy of the dataset, for the exact counts
+        ColumnarDataset data;
+        // Columnar copy of the sampled candidates
+        ColumnarDataset sample;
+        // Number of original records represented by each sampled candidate, empty if all are 1
+        std::vector<int> sample_weights;
+        // Number of original records in the dataset and in the sample
+        double total, sampled;
+        // Fraction of the combinations evaluated
+        float combinations;
+        // Threshold of the hash of a combination to evaluate it
+        uint64_t cutoff;
+        // Seed of the hash of the combinations
+        uint64_t seed;
+        // Kernel that counts the matches
+        match_kernel kernel;
+        // True if the risks are compared with the exact ones
+        bool validate;
+        // Number of counts estimated on the sample and recomputed exactly
+        mutable std::atomic<size_t> estimated{0}, fallbacks{0};
+        // Validation statistics, guarded by the mutex
+        mutable std::mutex stats_mutex;
+        mutable double sampled_time = 0, exact_time = 0, error_sum = 0, error_max = 0;
+        mutable size_t compared = 0, covered = 0, mismatches = 0;
+
+        /**
+         * @brief Number of sampled matches up to which a count is recomputed exactly.
+         */
+        static constexpr int FALLBACK = 10;
+        /**
+         * @brief Normal quantile of the two-sided 95% interval.
+         */
+        static constexpr double Z = 1.959964;
+
+        /**
+         * @brief Hash of a combination index, to sample the combinations.
+         */
+        static uint64_t mix(uint64_t x) {
+            // SplitMix64 finalizer
+            x += 0x9E3779B97F4A7C15ULL;
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+            return x ^ (x >> 31);
+        }
+
+        /**
+         * @brief Estimates the risk of a user for a background knowledge size.
+         *
+         * @param i Index of the user's record.
+         * @param h Background knowledge size.
+         * @param out Estimate, lower and upper end of the risk.
+         */
+        void estimate(size_t i, short h, float* out) const {
+            const float* u = dataset[i].features.data();
+            const int* w = weights.empty() ? nullptr : weights.data();
+            const int* sw = sample_weights.empty() ? nullptr : sample_weights.data();
+            std::vector<size_t> selected(h);
+            // Smallest estimated count and smallest ends of the count intervals
+            double min_count = INFINITY, min_low = INFINITY, min_high = INFINITY;
+            size_t counted = 0, exact = 0;
+            uint64_t index = 0;
+            CombinationsEnumerator comb(data.features(), h);
+            do {
+                // The first combination is always evaluated, so that every user gets a risk
+                if (index++ > 0 && combinations < 1 && mix(seed ^ index) > cutoff)
+                    continue;
+                for (size_t j = 0, k = 0; j < comb.mask.size(); j++)
+                    if (comb.mask[j])
+                        selected[k++] = j;
+                counted++;
+                double count, low, high;
+                int hits = kernel(sample, u, selected.data(), h, eps, sw, 0, sample.size());
+                if (hits <= FALLBACK) {
+                    // Few sampled matches: exact count on the whole dataset
+                    exact++;
+                    count = low = high = kernel(data, u, selected.data(), h, eps, w, 0, data.size());
+                    // A single match gives the risk
+                    if (count == 1) {
+                        min_count = min_low = min_high = 1;
+                        break;
+                    }
+                }
+                else {
+                    // Wilson interval of the sampled proportion, scaled to the dataset
+                    double p = hits / sampled;
+                    double z2 = Z * Z / sampled;
+                    double center = (p + z2 / 2) / (1 + z2);
+                    double half = Z * std::sqrt(p * (1 - p) / sampled + z2 / (4 * sampled)) / (1 + z2);
+                    count = p * total;
+                    low = std::max(0.0, center - half) * total;
+                    high = std::min(1.0, center + half) * total;
+                }
+                min_count = std::min(min_count, count);
+                min_low = std::min(min_low, low);
+                min_high = std::min(min_high, high);
+            } while (comb.next());
+            estimated.fetch_add(counted, std::memory_order_relaxed);
+            fallbacks.fetch_add(exact, std::memory_order_relaxed);
+            // Risk is the inverse of the minimum number of matches
+            out[0] = 1.0 / min_count;
+            out[1] = 1.0 / min_high;
+            out[2] = 1.0 / min_low;
+            // Combinations left out can only raise the risk
+            if (combinations < 1)
+                out[2] = std::max(out[2], 1.0f);
+        }
+
+        /**
+         * @brief Exact risk with the same kernel on the whole dataset.
+         */
+        float exact_risk(size_t i, short h) const {
+            const float* u = dataset[i].features.data();
+            std::vector<size_t> selected(h);
+            int min_matches = INT_MAX;
+            CombinationsEnumerator comb(data.features(), h);
+            do {
+                for (size_t j = 0, k = 0; j < comb.mask.size(); j++)
+                    if (comb.mask[j])
+                        selected[k++] = j;
+                int matches = kernel(data, u, selected.data(), h, eps, weights.empty() ? nullptr : weights.data(), 0, data.size());
+                if (matches == 1)
+                    return 1.0;
+                if (matches < min_matches)
+                    min_matches = matches;
+            } while (comb.next());
+            return 1.0 / min_matches;
+        }
+
+        /**
+         * @brief Compares an estimate with the exact risk, timing both.
+         */
+        void compare(size_t i, short h, const float* out, const double& elapsed) const {
+            auto start = std::chrono::steady_clock::now();
+            float expected = exact_risk(i, h);
+            double exact_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::unique_lock<std::mutex> lock(stats_mutex);
+            sampled_time += elapsed;
+            exact_time += exact_elapsed;
+            compared++;
+            if (out[1] <= expected && expected <= out[2])
+                covered++;
+            if (out[0] != expected) {
+                mismatches++;
+                double error = std::fabs(out[0] - expected);
+                if (std::isfinite(error)) {
+                    error_sum += error;
+                    error_max = std::max(error_max, error);
+                }
+            }
+        }
+    public:
+        /**
+         * @brief Construct a new sampled engine object.
+         *
+         * @param _dataset Global view of the dataset.
+         * @param _h_min Smallest background knowledge size.
+         * @param _h_max Largest background knowledge size.
+         * @param _eps Epsilon margin for the matching.
+         * @param fraction Fraction of the candidates in the sample, in (0, 1].
+         * @param stratified True for a sample stratified on the most selective feature.
+         * @param _combinations Fraction of the combinations evaluated, in (0, 1].
+         * @param _seed Seed of the sample and of the combinations.
+         * @param _kernel Kernel that counts the matches.
+         * @param _validate True if the risks are compared with the exact ones.
+         * @param _weights Number of original records represented by each record, empty if all are 1.
+         */
+        SampledEngine(
+            std::vector<Record>& _dataset,
+            const short& _h_min,
+            const short& _h_max,
+            const float& _eps,
+            const float& fraction,
+            const bool& stratified,
+            const float& _combinations,
+            const uint64_t& _seed,
+            match_kernel _kernel,
+            const bool& _validate,
+            const std::vector<int>& _weights = {}
+        ): Engine(_dataset, _h_min, _h_max, _eps, _weights), data(_dataset), sample(0, 0), combinations(_combinations),
+            cutoff(_combinations >= 1 ? UINT64_MAX : (uint64_t) (_combinations * 18446744073709551615.0)),
+            seed(_seed), kernel(_kernel), validate(_validate) {
+            std::vector<size_t> indices = sample_candidates(_dataset, _eps, fraction, stratified, _seed);
+            std::vector<Record> records;
+            records.reserve(indices.size());
+            for (size_t v: indices) {
+                records.push_back(_dataset[v]);
+                if (!_weights.empty())
+                    sample_weights.push_back(_weights[v]);
+            }
+            sample = ColumnarDataset(records);
+            total = _weights.empty() ? _dataset.size() : std::accumulate(_weights.begin(), _weights.end(), 0.0);
+            sampled = _weights.empty() ? records.size() : std::accumulate(sample_weights.begin(), sample_weights.end(), 0.0);
+        }
+
+        size_t width() const override {
+            return 3 * (h_max - h_min + 1);
+        }
+
+        /**
+         * @brief Names of the risk columns, "Risk", "Risk_low", "Risk_high" for every size.
+         */
+        std::vector<std::string> columns() const override {
+            std::vector<std::string> names;
+            for (const std::string& name: risk_columns(h_min, h_max))
+                for (const char* suffix: { "", "_low", "_high" })
+                    names.push_back(name + suffix);
+            return names;
+        }
+
+        float assess_risk(size_t i, short h) const override {
+            float out[3];
+            estimate(i, h, out);
+            return out[0];
+        }
+
+        void assess_risks(size_t i, float* risks) const override {
+            for (short h = h_min; h <= h_max; h++) {
+                float* out = risks + 3 * (h - h_min);
+                auto start = std::chrono::steady_clock::now();
+                estimate(i, h, out);
+                if (validate)
+                    compare(i, h, out, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+        }
+
+        /**
+         * @brief Size of the sample and fraction of the counts recomputed exactly; in validation
+         * mode the speedup over the exact counts, the error of the estimates and the fraction of
+         * exact risks within their interval.
+         */
+        std::string report() const override {
+            std::ostringstream stream;
+            stream << " Sample: " << sample.size() << "/" << data.size()
+                   << " Fallbacks: " << (estimated.load() ? 100.0 * fallbacks.load() / estimated.load() : 0.0) << "%";
+            if (validate) {
+                std::unique_lock<std::mutex> lock(stats_mutex);
+                stream << " Speedup: " << (sampled_time > 0 ? exact_time / sampled_time : 0.0) << "x"
+                       << " Mismatches: " << mismatches << "/" << compared
+                       << " MAE: " << (compared ? error_sum / compared : 0.0) << " Max error: " << error_max
+                       << " Coverage: " << (compared ? 100.0 * covered / compared : 0.0) << "%";
+            }
+            return stream.str();
+        }
+    };
+} // namespace prudence
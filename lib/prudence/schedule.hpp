@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include <prudence/columnar.hpp>
+#include <prudence/range.hpp>
+
+namespace prudence {
+    /**
+     * @brief Records reordered from the most to the least expensive to compute.
+     */
+    struct CostSchedule {
+        // Records in the order of computation
+        std::vector<Record> records;
+        // Weights of the reordered records, empty if all are 1
+        std::vector<int> weights;
+        // Original index of each reordered record
+        std::vector<size_t> order;
+
+        /**
+         * @brief Brings a risk matrix computed on the reordered records back to the original order.
+         * 
+         * @param risks Matrix of risks of the reordered records, stored row by row.
+         * @param width Number of risk values of each row.
+         * @return std::vector<float> Matrix of risks in the original order.
+         */
+        std::vector<float> restore(const std::vector<float>& risks, const size_t& width) const {
+            std::vector<float> restored(risks.size());
+            for (size_t k = 0; k < order.size(); k++)
+                std::copy_n(risks.begin() + k * width, width, restored.begin() + order[k] * width);
+            return restored;
+        }
+    };
+
+    /**
+     * @brief Orders the records by a cheap prediction of their cost. A user stops at the first
+     * combination with a single match, so a user with few candidates on some feature finishes
+     * early, while a user in a dense region walks all the combinations. The prediction is the
+     * smallest number of candidates matching the user on a single feature (the h = 1 counts,
+     * found on the sorted columns), with ties broken by the total number of such candidates.
+     * 
+     * @param records Records to schedule.
+     * @param weights Weights of the records, empty if all are 1.
+     * @param eps Epsilon margin for the matching.
+     * @return CostSchedule Records and weights from the most to the least expensive.
+     */
+    inline CostSchedule schedule_by_cost(const std::vector<Record>& records, const std::vector<int>& weights, const float& eps) {
+        ColumnarDataset columns(records);
+        RangeIndex index(columns, eps);
+        size_t n = records.size();
+        // Predicted cost of each record, as (min, sum) of the counts on single features
+        std::vector<std::pair<size_t, size_t>> cost(n, { 0, 0 });
+        for (size_t i = 0; i < n; i++) {
+            size_t min = n, sum = 0;
+            for (size_t j = 0; j < columns.features(); j++) {
+                size_t count = index.range(j, columns.at(i, j)).size();
+                min = std::min(min, count);
+                sum += count;
+            }
+            cost[i] = { min, sum };
+        }
+        CostSchedule schedule;
+        schedule.order.resize(n);
+        std::iota(schedule.order.begin(), schedule.order.end(), 0);
+        std::stable_sort(schedule.order.begin(), schedule.order.end(), [&cost](const size_t& a, const size_t& b) {
+            return cost[a] > cost[b];
+        });
+        for (size_t i: schedule.order) {
+            schedule.records.push_back(records[i]);
+            if (!weights.empty())
+                schedule.weights.push_back(weights[i]);
+        }
+        return schedule;
+    }
+
+    /**
+     * @brief Size of the next chunk in guided self-scheduling: half of the even share of the
+     * remaining records, so that the chunks shrink as the computation approaches the end.
+     * 
+     * @param remaining Number of records not assigned yet.
+     * @param nw Number of workers.
+     * @param min_chunk Smallest chunk size.
+     */
+    inline size_t guided_chunk_size(const size_t& remaining, const short& nw, const size_t& min_chunk = 1) {
+        return std::min(remaining, std::max(min_chunk, (remaining + 2 * nw - 1) / (2 * nw)));
+    }
+
+    /**
+     * @brief Splits the records into guided chunks, for the executors that take a list of chunks.
+     * 
+     * @param n Number of records.
+     * @param nw Number of workers.
+     * @return std::vector<std::pair<size_t, size_t>> Begin and end of each chunk.
+     */
+    inline std::vector<std::pair<size_t, size_t>> guided_chunks(const size_t& n, const short& nw) {
+        std::vector<std::pair<size_t, size_t>> chunks;
+        for (size_t begin = 0; begin < n; begin = chunks.back().second)
+            chunks.push_back({ begin, begin + guided_chunk_size(n - begin, nw) });
+        return chunks;
+    }
+} // namespace prudence
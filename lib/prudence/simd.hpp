@@ -0,0 +1,248 @@
+#pragma once
+
+#include <climits>
+#include <string>
+#include <vector>
+
+#include <immintrin.h>
+
+#include <prudence/columnar.hpp>
+#include <prudence/engine.hpp>
+
+namespace prudence {
+    /**
+     * @brief Kernel that counts the candidates in [begin, end) matching a user on a combination.
+     * begin must be a multiple of 16 for the vector kernels to use aligned loads.
+     * 
+     * @param dataset Columnar view of the dataset.
+     * @param u Values of the features of the user.
+     * @param selected Indices of the features in the combination.
+     * @param h Number of features in the combination.
+     * @param eps Epsilon margin for the matching.
+     * @param weights Number of original records represented by each candidate, nullptr if all are 1.
+     * @param begin First candidate.
+     * @param end One past the last candidate.
+     * @return int Number of matches.
+     */
+    using match_kernel = int (*)(
+        const ColumnarDataset&, const float*, const size_t*, const short&, const float&, const int*, const size_t&, const size_t&
+    );
+
+    /**
+     * @brief Checks a single candidate, with the same bounds of Record::matches.
+     */
+    inline bool matches_candidate(
+        const ColumnarDataset& dataset,
+        const float* u,
+        const size_t* selected,
+        const short& h,
+        const float& eps,
+        const size_t& v
+    ) {
+        for (short k = 0; k < h; k++) {
+            size_t j = selected[k];
+            float value = dataset.column(j)[v];
+            float lo = value - value * eps;
+            float hi = value + value * eps;
+            if (u[j] < lo || u[j] > hi)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Scalar kernel, used as fallback and for the tail of the vector kernels.
+     */
+    inline int count_matches_scalar(
+        const ColumnarDataset& dataset,
+        const float* u,
+        const size_t* selected,
+        const short& h,
+        const float& eps,
+        const int* weights,
+        const size_t& begin,
+        const size_t& end
+    ) {
+        int matches = 0;
+        for (size_t v = begin; v < end; v++)
+            if (matches_candidate(dataset, u, selected, h, eps, v))
+                matches += weights ? weights[v] : 1;
+        return matches;
+    }
+
+    /**
+     * @brief AVX2 kernel testing 8 candidates per instruction.
+     */
+    __attribute__((target("avx2")))
+    inline int count_matches_avx2(
+        const ColumnarDataset& dataset,
+        const float* u,
+        const size_t* selected,
+        const short& h,
+        const float& eps,
+        const int* weights,
+        const size_t& begin,
+        const size_t& end
+    ) {
+        const __m256 veps = _mm256_set1_ps(eps);
+        size_t n = end;
+        size_t v = begin;
+        int matches = 0;
+        // Weights of the matching candidates, lane by lane
+        __m256i weighted = _mm256_setzero_si256();
+        for (; v + 8 <= n; v += 8) {
+            __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (short k = 0; k < h; k++) {
+                size_t j = selected[k];
+                __m256 value = _mm256_load_ps(dataset.column(j) + v);
+                __m256 delta = _mm256_mul_ps(value, veps);
+                __m256 lo = _mm256_sub_ps(value, delta);
+                __m256 hi = _mm256_add_ps(value, delta);
+                __m256 uj = _mm256_set1_ps(u[j]);
+                // Negated comparisons keep the semantics of Record::matches
+                mask = _mm256_and_ps(mask, _mm256_cmp_ps(uj, lo, _CMP_NLT_UQ));
+                mask = _mm256_and_ps(mask, _mm256_cmp_ps(uj, hi, _CMP_NGT_UQ));
+                if (_mm256_testz_ps(mask, mask))
+                    break;
+            }
+            if (weights)
+                weighted = _mm256_add_epi32(weighted, _mm256_and_si256(
+                    _mm256_castps_si256(mask),
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + v))
+                ));
+            else
+                matches += __builtin_popcount(_mm256_movemask_ps(mask));
+        }
+        alignas(32) int lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), weighted);
+        for (int lane: lanes)
+            matches += lane;
+        for (; v < n; v++)
+            if (matches_candidate(dataset, u, selected, h, eps, v))
+                matches += weights ? weights[v] : 1;
+        return matches;
+    }
+
+    /**
+     * @brief AVX-512 kernel testing 16 candidates per instruction.
+     */
+    __attribute__((target("avx512f")))
+    inline int count_matches_avx512(
+        const ColumnarDataset& dataset,
+        const float* u,
+        const size_t* selected,
+        const short& h,
+        const float& eps,
+        const int* weights,
+        const size_t& begin,
+        const size_t& end
+    ) {
+        const __m512 veps = _mm512_set1_ps(eps);
+        size_t n = end;
+        size_t v = begin;
+        int matches = 0;
+        // Weights of the matching candidates, lane by lane
+        __m512i weighted = _mm512_setzero_si512();
+        for (; v + 16 <= n; v += 16) {
+            __mmask16 mask = 0xFFFF;
+            for (short k = 0; k < h && mask; k++) {
+                size_t j = selected[k];
+                __m512 value = _mm512_load_ps(dataset.column(j) + v);
+                // The explicit rounding keeps the product from being fused with the
+                // following add/sub (AVX-512 implies FMA), which would change the bounds
+                __m512 delta = _mm512_maskz_mul_round_ps(0xFFFF, value, veps, _MM_FROUND_CUR_DIRECTION);
+                __m512 lo = _mm512_sub_ps(value, delta);
+                __m512 hi = _mm512_add_ps(value, delta);
+                __m512 uj = _mm512_set1_ps(u[j]);
+                // Negated comparisons keep the semantics of Record::matches
+                mask = _mm512_mask_cmp_ps_mask(mask, uj, lo, _CMP_NLT_UQ);
+                mask = _mm512_mask_cmp_ps_mask(mask, uj, hi, _CMP_NGT_UQ);
+            }
+            if (weights)
+                weighted = _mm512_mask_add_epi32(weighted, mask, weighted, _mm512_loadu_si512(weights + v));
+            else
+                matches += __builtin_popcount(mask);
+        }
+        alignas(64) int lanes[16];
+        _mm512_store_si512(lanes, weighted);
+        for (int lane: lanes)
+            matches += lane;
+        for (; v < n; v++)
+            if (matches_candidate(dataset, u, selected, h, eps, v))
+                matches += weights ? weights[v] : 1;
+        return matches;
+    }
+
+    /**
+     * @brief Selects the widest kernel supported by the CPU.
+     * 
+     * @param name One of "auto", "avx512", "avx2" and "scalar".
+     * @return match_kernel The kernel, or nullptr if the name is unknown or not supported.
+     */
+    inline match_kernel select_kernel(const std::string& name) {
+        __builtin_cpu_init();
+        bool avx512 = __builtin_cpu_supports("avx512f");
+        bool avx2 = __builtin_cpu_supports("avx2");
+        if (name == "avx512" || (name == "auto" && avx512))
+            return avx512 ? count_matches_avx512 : nullptr;
+        if (name == "avx2" || (name == "auto" && avx2))
+            return avx2 ? count_matches_avx2 : nullptr;
+        if (name == "scalar" || name == "auto")
+            return count_matches_scalar;
+        return nullptr;
+    }
+
+    /**
+     * @brief Engine that scans a columnar copy of the dataset with vector kernels.
+     */
+    class SimdEngine: public Engine {
+    private:
+        // Columnar copy of the dataset
+        ColumnarDataset columns;
+        // Kernel that counts the matches
+        match_kernel kernel;
+    public:
+        /**
+         * @brief Construct a new SIMD engine object.
+         * 
+         * @param _dataset Global view of the dataset.
+         * @param _h_min Smallest background knowledge size.
+         * @param _h_max Largest background knowledge size.
+         * @param _eps Epsilon margin for the matching.
+         * @param _kernel Kernel that counts the matches.
+         * @param _weights Number of original records represented by each record, empty if all are 1.
+         */
+        SimdEngine(
+            std::vector<Record>& _dataset,
+            const short& _h_min,
+            const short& _h_max,
+            const float& _eps,
+            match_kernel _kernel,
+            const std::vector<int>& _weights = {}
+        ): Engine(_dataset, _h_min, _h_max, _eps, _weights), columns(_dataset), kernel(_kernel) {}
+
+        float assess_risk(size_t i, short h) const override {
+            const float* u = dataset[i].features.data();
+            // Indices of the features in the current combination
+            std::vector<size_t> selected(h);
+            // Minimum number of matches for a combination
+            int min_matches = INT_MAX;
+            CombinationsEnumerator comb(columns.features(), h);
+            do {
+                for (size_t j = 0, k = 0; j < comb.mask.size(); j++)
+                    if (comb.mask[j])
+                        selected[k++] = j;
+                // Number of matches for the combination
+                int matches = kernel(columns, u, selected.data(), h, eps, weights.empty() ? nullptr : weights.data(), 0, columns.size());
+                // If we have only 1 match the combination gives the risk
+                if (matches == 1)
+                    return 1.0;
+                // Else we take the minimum number of matches found
+                if (matches < min_matches)
+                    min_matches = matches;
+            } while (comb.next());
+            // Risk is the inverse of the minimum number of matches
+            return 1.0 / min_matches;
+        }
+    };
+} // namespace prudence
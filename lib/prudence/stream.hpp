@@ -0,0 +1,487 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <combinations.hpp>
+#include <prudence/binary.hpp>
+#include <prudence/columnar.hpp>
+#include <prudence/loader.hpp>
+#include <prudence/pool.hpp>
+#include <prudence/simd.hpp>
+
+namespace prudence {
+    /**
+     * @brief Sequential reader of a dataset in blocks of records, that never holds more than
+     * one block in memory.
+     */
+    class BlockReader {
+    public:
+        virtual ~BlockReader() {}
+
+        /**
+         * @brief Number of features of the records.
+         */
+        virtual size_t features() const = 0;
+
+        /**
+         * @brief Goes back to the first record.
+         */
+        virtual void rewind() = 0;
+
+        /**
+         * @brief Reads the next records into a block.
+         * 
+         * @param block Columnar block to fill, resized to the number of records read.
+         * @param ids If not null, filled with the IDs of the records read.
+         * @return size_t Number of records read, 0 at the end of the dataset.
+         */
+        virtual size_t read(ColumnarDataset& block, std::vector<std::string>* ids) = 0;
+
+        /**
+         * @brief Number of bytes read since the reader has been opened.
+         */
+        size_t bytes = 0;
+    };
+
+    /**
+     * @brief Block reader of a CSV dataset, parsing one row at a time.
+     */
+    class CsvBlockReader: public BlockReader {
+    private:
+        // Stream of the file
+        std::ifstream input;
+        // Index of the column representing the ID
+        int id_index;
+        // Number of features
+        size_t m;
+        // Position of the first row after the header
+        std::streampos body;
+        // Current row
+        std::string row;
+        // Record parsed from the current row
+        Record record;
+    public:
+        /**
+         * @brief Opens a CSV dataset, reading the number of features from the header.
+         * 
+         * @param path Path of the file.
+         * @param _id_index Index of the column representing the ID.
+         */
+        CsvBlockReader(const std::string& path, const int& _id_index): input(path, std::ios::binary), id_index(_id_index), m(0) {
+            if (!std::getline(input, row))
+                return;
+            m = std::count(row.begin(), row.end(), ',');
+            body = input.tellg();
+        }
+
+        /**
+         * @brief Checks if the file has been opened.
+         */
+        bool is_open() const {
+            return input.is_open();
+        }
+
+        size_t features() const override {
+            return m;
+        }
+
+        void rewind() override {
+            input.clear();
+            input.seekg(body);
+        }
+
+        size_t read(ColumnarDataset& block, std::vector<std::string>* ids) override {
+            size_t count = 0;
+            if (ids)
+                ids->clear();
+            while (count < block.capacity() && std::getline(input, row)) {
+                bytes += row.size() + 1;
+                // Drops the carriage return of Windows line endings
+                if (!row.empty() && row.back() == '\r')
+                    row.pop_back();
+                if (row.empty())
+                    continue;
+                record.features.assign(m, 0);
+                parse_row(row.data(), row.data() + row.size(), id_index, record);
+                for (size_t j = 0; j < m; j++)
+                    block.column(j)[count] = record.features[j];
+                if (ids)
+                    ids->push_back(record.id);
+                count++;
+            }
+            block.resize(count);
+            return count;
+        }
+    };
+
+    /**
+     * @brief Block reader of a binary dataset (see binary.hpp), reading a slice of every column.
+     */
+    class BinaryBlockReader: public BlockReader {
+    private:
+        // Stream of the file
+        std::ifstream input;
+        // Number of records
+        uint64_t n = 0;
+        // Number of features
+        uint64_t m = 0;
+        // Offsets of the columns, of the ID offsets and of the ID bytes
+        uint64_t columns = 0, offsets = 0, id_bytes = 0;
+        // Index of the next record
+        uint64_t position = 0;
+        // Raw bytes of a slice
+        std::vector<char> buffer;
+
+        /**
+         * @brief Reads bytes at an offset of the file.
+         */
+        bool read_at(const uint64_t& offset, char* data, const size_t& size) {
+            input.seekg(offset);
+            input.read(data, size);
+            bytes += size;
+            return (size_t) input.gcount() == size;
+        }
+    public:
+        /**
+         * @brief Opens a binary dataset, reading its header.
+         * 
+         * @param path Path of the file.
+         */
+        BinaryBlockReader(const std::string& path): input(path, std::ios::binary) {
+            char header[sizeof(BINARY_MAGIC) + 24];
+            if (!input.read(header, sizeof(header)) || !is_binary_dataset(header, sizeof(header))
+                || read_le<uint32_t>(header + sizeof(BINARY_MAGIC)) != BINARY_VERSION) {
+                input.close();
+                return;
+            }
+            n = read_le<uint64_t>(header + sizeof(BINARY_MAGIC) + 8);
+            m = read_le<uint64_t>(header + sizeof(BINARY_MAGIC) + 16);
+            // Skips the feature names
+            uint64_t offset = sizeof(header);
+            for (uint64_t j = 0; j < m; j++) {
+                char length[4];
+                if (!read_at(offset, length, 4)) {
+                    input.close();
+                    return;
+                }
+                offset += 4 + read_le<uint32_t>(length);
+            }
+            columns = (offset + BINARY_ALIGNMENT - 1) / BINARY_ALIGNMENT * BINARY_ALIGNMENT;
+            offsets = columns + n * m * sizeof(float);
+            id_bytes = offsets + (n + 1) * sizeof(uint64_t);
+        }
+
+        /**
+         * @brief Checks if the file has been opened and has a valid header.
+         */
+        bool is_open() const {
+            return input.is_open();
+        }
+
+        size_t features() const override {
+            return m;
+        }
+
+        void rewind() override {
+            input.clear();
+            position = 0;
+        }
+
+        size_t read(ColumnarDataset& block, std::vector<std::string>* ids) override {
+            size_t count = std::min<uint64_t>(block.capacity(), n - position);
+            buffer.resize(std::max<size_t>(count * sizeof(float), (count + 1) * sizeof(uint64_t)));
+            for (uint64_t j = 0; j < m && count > 0; j++) {
+                if (!read_at(columns + (j * n + position) * sizeof(float), buffer.data(), count * sizeof(float)))
+                    count = 0;
+                float* column = block.column(j);
+                for (size_t v = 0; v < count; v++) {
+                    uint32_t bits = read_le<uint32_t>(buffer.data() + v * sizeof(float));
+                    std::memcpy(&column[v], &bits, sizeof(float));
+                }
+            }
+            if (ids) {
+                ids->clear();
+                if (count > 0 && read_at(offsets + position * sizeof(uint64_t), buffer.data(), (count + 1) * sizeof(uint64_t))) {
+                    std::vector<uint64_t> bounds(count + 1);
+                    for (size_t v = 0; v <= count; v++)
+                        bounds[v] = read_le<uint64_t>(buffer.data() + v * sizeof(uint64_t));
+                    std::string text(bounds[count] - bounds[0], '\0');
+                    read_at(id_bytes + bounds[0], &text[0], text.size());
+                    for (size_t v = 0; v < count; v++)
+                        ids->push_back(text.substr(bounds[v] - bounds[0], bounds[v + 1] - bounds[v]));
+                }
+            }
+            position += count;
+            block.resize(count);
+            return count;
+        }
+    };
+
+    /**
+     * @brief Opens a block reader on a CSV or binary dataset, detected from the magic bytes.
+     * 
+     * @param path Path of the file.
+     * @param id_index Index of the column representing the ID (CSV only).
+     * @return std::unique_ptr<BlockReader> The reader, or nullptr if the file can't be opened.
+     */
+    inline std::unique_ptr<BlockReader> open_block_reader(const std::string& path, const int& id_index) {
+        char magic[sizeof(BINARY_MAGIC)] = {};
+        std::ifstream probe(path, std::ios::binary);
+        if (!probe.is_open())
+            return nullptr;
+        probe.read(magic, sizeof(magic));
+        if (is_binary_dataset(magic, probe.gcount())) {
+            auto reader = std::make_unique<BinaryBlockReader>(path);
+            return reader->is_open() ? std::move(reader) : nullptr;
+        }
+        auto reader = std::make_unique<CsvBlockReader>(path, id_index);
+        return reader->is_open() ? std::move(reader) : nullptr;
+    }
+
+    /**
+     * @brief Computes the risks of a dataset that doesn't fit in memory. Users are taken in
+     * blocks; for each user block the candidates are streamed from disk in blocks, the next
+     * candidate block being read by a background task while the current one is counted.
+     * Each (user, combination) pair keeps its partial match count until the candidates are
+     * over, then every user gets its risk and the block is written to the output.
+     */
+    class StreamEvaluator {
+    private:
+        // Reader of the user blocks
+        BlockReader& users;
+        // Reader of the candidate blocks
+        BlockReader& candidates;
+        // Smallest background knowledge size
+        short h_min;
+        // Largest background knowledge size
+        short h_max;
+        // Epsilon margin for the matching
+        float eps;
+        // Number of threads counting a block
+        short nw;
+        // Kernel that counts the matches on a candidate block
+        match_kernel kernel;
+        // Selected features of every combination, all the sizes one after the other
+        std::vector<size_t> selected;
+        // Number of features of each combination
+        std::vector<size_t> sizes;
+        // Index of the first combination of each background knowledge size, plus the total
+        std::vector<size_t> first;
+        // Number of candidates, known after the first pass, 0 before
+        size_t total = 0;
+        // Candidates counted between two checks of the bound, a multiple of the kernel width
+        static constexpr size_t PIECE = 1024;
+
+        /**
+         * @brief Adds the matches of a candidate block to the counts of a user for one size.
+         * In the last block the counts become complete, so they are bounded as in the scan:
+         * a count stops at the smallest complete one (or 2), and a single match ends the size.
+         * In the other blocks a count that exceeds the smallest possible final count (its
+         * partial count plus the candidates left) can no longer be the minimum, so it stops.
+         *
+         * @param block Candidate block.
+         * @param u Index of the user in the user block.
+         * @param l Index of the size.
+         * @param values Values of the features of the user.
+         * @param remaining Candidates not counted yet including the block, -1 if unknown.
+         * @param last True if the block is the last one.
+         * @param counts Partial match counts, one row of combinations per user.
+         * @param live Flags of the combinations whose counts continue.
+         * @param single Flags of the sizes with a single match, one row of sizes per user.
+         */
+        void count_level(
+            const ColumnarDataset& block,
+            const size_t& u,
+            const size_t& l,
+            const float* values,
+            const long long& remaining,
+            const bool& last,
+            std::vector<int>& counts,
+            std::vector<uint8_t>& live,
+            std::vector<uint8_t>& single
+        ) const {
+            size_t combinations = sizes.size();
+            int* row = &counts[u * combinations];
+            uint8_t* alive = &live[u * combinations];
+            // Smallest final count, among the complete ones in the last block or the possible ones before
+            long long bound = LLONG_MAX;
+            if (!last && remaining >= 0)
+                for (size_t c = first[l]; c < first[l + 1]; c++)
+                    if (alive[c])
+                        bound = std::min(bound, row[c] + remaining);
+            size_t offset = 0;
+            for (size_t c = 0; c < first[l]; c++)
+                offset += sizes[c];
+            for (size_t c = first[l]; c < first[l + 1]; offset += sizes[c], c++) {
+                if (!alive[c])
+                    continue;
+                // Largest count worth knowing exactly
+                long long limit = last ? std::max<long long>(bound, 2) : (bound == LLONG_MAX) ? bound : std::max<long long>(bound, 1) + 1;
+                for (size_t begin = 0; begin < block.size() && row[c] < limit; begin += PIECE)
+                    row[c] += kernel(block, values, &selected[offset], sizes[c], eps, nullptr, begin, std::min(block.size(), begin + PIECE));
+                if (last) {
+                    // If we have only 1 match the combination gives the risk
+                    if (row[c] == 1) {
+                        single[u * sizes_count() + l] = 1;
+                        return;
+                    }
+                    bound = std::min<long long>(bound, row[c]);
+                }
+                // Above the bound the count can no longer be the minimum, nor a single match
+                else if (row[c] >= limit)
+                    alive[c] = 0;
+            }
+        }
+
+        /**
+         * @brief Number of background knowledge sizes.
+         */
+        size_t sizes_count() const {
+            return first.size() - 1;
+        }
+    public:
+        // Number of users in a block
+        size_t user_block = 0;
+        // Number of candidates in a block
+        size_t candidate_block = 0;
+
+        /**
+         * @brief Construct a new stream evaluator object, splitting the memory budget between
+         * the user block with its partial counts and the two candidate blocks.
+         * 
+         * @param _users Reader of the user blocks.
+         * @param _candidates Reader of the candidate blocks, on the same dataset.
+         * @param _h_min Smallest background knowledge size.
+         * @param _h_max Largest background knowledge size.
+         * @param _eps Epsilon margin for the matching.
+         * @param _nw Number of threads counting a block.
+         * @param _kernel Kernel that counts the matches on a candidate block.
+         * @param budget Memory budget in bytes.
+         */
+        StreamEvaluator(
+            BlockReader& _users,
+            BlockReader& _candidates,
+            const short& _h_min,
+            const short& _h_max,
+            const float& _eps,
+            const short& _nw,
+            match_kernel _kernel,
+            const size_t& budget
+        ): users(_users), candidates(_candidates), h_min(_h_min), h_max(_h_max), eps(_eps), nw(std::max<short>(_nw, 1)), kernel(_kernel) {
+            size_t m = users.features();
+            first.push_back(0);
+            for (short h = h_min; h <= h_max; h++) {
+                // A size larger than the features selects all of them, like CombinationsEnumerator
+                size_t k = std::min<size_t>(h, m);
+                CombinationsEnumerator comb(m, k);
+                do {
+                    for (size_t j = 0; j < m; j++)
+                        if (comb.mask[j])
+                            selected.push_back(j);
+                    sizes.push_back(k);
+                } while (comb.next());
+                first.push_back(sizes.size());
+            }
+            size_t combinations = sizes.size();
+            size_t fixed = selected.size() * sizeof(size_t) + combinations * sizeof(size_t);
+            size_t available = budget > fixed ? budget - fixed : 0;
+            // Half of the budget to the two candidate blocks, half to the user block
+            candidate_block = available / 2 / (2 * std::max<size_t>(m, 1) * sizeof(float)) / 16 * 16;
+            // A user takes its column and row values, a count and a live flag per combination,
+            // a single flag per size and its ID
+            size_t per_user = 2 * m * sizeof(float) + combinations * (sizeof(int) + sizeof(uint8_t)) + sizes_count() * sizeof(uint8_t) + 64;
+            user_block = available / 2 / per_user;
+        }
+
+        /**
+         * @brief Runs the computation, writing the header and a row for each user.
+         * 
+         * @param output_stream Stream of the output CSV.
+         * @return true If the budget fits at least a user and a block of 16 candidates.
+         * @return false Otherwise.
+         */
+        bool run(std::ostream& output_stream) {
+            if (user_block == 0 || candidate_block == 0)
+                return false;
+            size_t m = users.features();
+            size_t combinations = sizes.size();
+            size_t levels = sizes_count();
+            std::vector<std::string> names = risk_columns(h_min, h_max);
+            output_stream << "ID";
+            for (const std::string& name: names)
+                output_stream << "," << name;
+            output_stream << std::endl;
+            ColumnarDataset user_columns(user_block, m);
+            std::vector<std::string> ids;
+            // Two candidate blocks, one counted while the other is read
+            ColumnarDataset blocks[2] = { ColumnarDataset(candidate_block, m), ColumnarDataset(candidate_block, m) };
+            // Partial match counts, one row of combinations per user
+            std::vector<int> counts;
+            // 0 for the combinations that can no longer give the risk, whose counts stop
+            std::vector<uint8_t> live;
+            // 1 for the sizes of a user with a combination of a single match
+            std::vector<uint8_t> single;
+            // Values of the features of a user
+            std::vector<float> values(user_columns.capacity() * m);
+            // Threads counting the blocks, started once
+            ComputePool pool(nw);
+            while (users.read(user_columns, &ids) > 0) {
+                size_t count = user_columns.size();
+                for (size_t u = 0; u < count; u++)
+                    for (size_t j = 0; j < m; j++)
+                        values[u * m + j] = user_columns.at(u, j);
+                counts.assign(count * combinations, 0);
+                live.assign(count * combinations, 1);
+                single.assign(count * levels, 0);
+                candidates.rewind();
+                // Candidates counted in this pass
+                size_t processed = 0;
+                int current = 0;
+                std::future<size_t> next = std::async(std::launch::async, [this, &blocks]() { return candidates.read(blocks[0], nullptr); });
+                while (next.get() > 0) {
+                    // Prefetches the following block
+                    next = std::async(std::launch::async, [this, &blocks, current]() { return candidates.read(blocks[1 - current], nullptr); });
+                    const ColumnarDataset& block = blocks[current];
+                    // Candidates not counted yet, this block included, if the size of the dataset is known
+                    long long remaining = total > 0 ? (long long) (total - processed) : -1;
+                    // The counts are complete after the last block
+                    bool last = total > 0 ? processed + block.size() == total : block.size() < block.capacity();
+                    // Counts the block, each thread on a share of the users
+                    pool.run(nw, [&](const size_t& t) {
+                        for (size_t u = count * t / nw; u < count * (t + 1) / nw; u++)
+                            for (size_t l = 0; l < levels; l++)
+                                if (!single[u * levels + l])
+                                    count_level(block, u, l, &values[u * m], remaining, last, counts, live, single);
+                    });
+                    processed += block.size();
+                    current = 1 - current;
+                }
+                total = processed;
+                // Risk of each size from the complete counts
+                for (size_t u = 0; u < count; u++) {
+                    output_stream << ids[u];
+                    for (size_t l = 0; l < levels; l++) {
+                        // If we have only 1 match in some combination it gives the risk
+                        bool one = single[u * levels + l];
+                        int min_matches = INT_MAX;
+                        for (size_t c = first[l]; c < first[l + 1]; c++)
+                            if (live[u * combinations + c]) {
+                                one = one || counts[u * combinations + c] == 1;
+                                min_matches = std::min(min_matches, counts[u * combinations + c]);
+                            }
+                        output_stream << "," << (one ? 1.0f : (float) (1.0 / min_matches));
+                    }
+                    output_stream << std::endl;
+                }
+            }
+            return true;
+        }
+    };
+} // namespace prudence
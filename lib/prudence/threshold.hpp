@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <combinations.hpp>
+#include <prudence/engine.hpp>
+#include <prudence/pruned.hpp>
+
+namespace prudence {
+    /**
+     * @brief Engine that only decides which users are selected, instead of computing every risk:
+     * - threshold mode: a user is selected if its risk is at least t, that is as soon as a
+     *   combination has at most floor(1/t) matches; its risk is then only known from below;
+     * - top-k mode: the k riskiest users are selected, with their exact risk. A shared heap keeps
+     *   the k smallest counts found so far, and a user whose count cannot get within the largest
+     *   of them is dropped.
+     * The counts are bounded by the limit, and the most selective features come first so that
+     * small counts are found early. Users that are not selected get a risk of 0.
+     */
+    class DecisionEngine: public Engine {
+    private:
+        // Risk threshold, 0 in top-k mode
+        float threshold;
+        // Number of users to select in top-k mode
+        size_t k;
+        // Features in the order of enumeration
+        std::vector<size_t> order;
+        // Largest count of a user that can still be selected
+        mutable std::atomic<int> limit;
+        // Counts of the k riskiest users found so far, the largest on top
+        mutable std::priority_queue<int> heap;
+        // Guards the heap
+        mutable std::mutex heap_mutex;
+        // Combinations counted and candidates checked
+        mutable PruningCounters counters;
+
+        /**
+         * @brief Largest count whose risk, rounded as the other engines do, is at least the
+         * threshold: floor(1/t), corrected for the rounding of t and of the risk.
+         */
+        static int count_limit(const float& threshold) {
+            double estimate = std::min<double>(std::floor(1.0 / threshold), INT_MAX - 2);
+            int c = std::max<int>(estimate, 1);
+            while (c < INT_MAX - 1 && (float) (1.0 / (c + 1)) >= threshold)
+                c++;
+            while (c > 1 && (float) (1.0 / c) < threshold)
+                c--;
+            return c;
+        }
+
+        /**
+         * @brief Walks the combinations of a user, with the counts bounded by the limit.
+         *
+         * @param comb Enumerator of the combinations.
+         * @param count Function that counts the matches of the current combination, up to a bound.
+         * @param counted Incremented by the number of combinations counted.
+         * @return int 1 if a combination has a single match, else the smallest count; in threshold
+         * mode the first count within the limit. A count above the limit may be truncated.
+         */
+        template <typename Enumerator, typename Count>
+        int decide(Enumerator& comb, Count&& count, size_t& counted) const {
+            int min_matches = INT_MAX;
+            do {
+                int current = limit.load(std::memory_order_relaxed);
+                counted++;
+                // Counts above the limit or the minimum don't matter, while a single match does
+                int bound = std::max(std::min(min_matches, current + 1), 2);
+                int matches = count(bound);
+                if (matches == 1 || (threshold > 0 && matches <= current))
+                    return matches;
+                if (matches < min_matches)
+                    min_matches = matches;
+            } while (comb.next());
+            return min_matches;
+        }
+
+        /**
+         * @brief Walks the combinations of exactly H features, relabeled by the order.
+         */
+        template <size_t H>
+        int decide_fixed(const Record& u, size_t& counted, size_t& visited) const {
+            FixedCombinationsEnumerator<H> comb(u.features.size());
+            std::array<uint8_t, H> selected;
+            return decide(comb, [&](const int& bound) {
+                for (size_t k = 0; k < H; k++)
+                    selected[k] = order[comb.indices[k]];
+                return matches_combination<H>(u, dataset, eps, selected, weights, bound, &visited);
+            }, counted);
+        }
+
+        /**
+         * @brief Walks the combinations of any size, relabeled by the order.
+         */
+        int decide_generic(Record& u, const short& h, size_t& counted, size_t& visited) const {
+            CombinationsEnumerator comb(u.features.size(), h);
+            std::vector<bool> mask(u.features.size());
+            return decide(comb, [&](const int& bound) {
+                for (size_t j = 0; j < comb.mask.size(); j++)
+                    mask[order[j]] = comb.mask[j];
+                return matches_combination(u, dataset, eps, mask, weights, bound, &visited);
+            }, counted);
+        }
+    public:
+        /**
+         * @brief Construct a new decision engine object.
+         *
+         * @param _dataset Global view of the dataset.
+         * @param _h Background knowledge size.
+         * @param _eps Epsilon margin for the matching.
+         * @param _threshold Risk threshold in (0, 1], 0 for the top-k mode.
+         * @param _k Number of users to select in top-k mode.
+         * @param _weights Number of original records represented by each record, empty if all are 1.
+         */
+        DecisionEngine(
+            std::vector<Record>& _dataset,
+            const short& _h,
+            const float& _eps,
+            const float& _threshold,
+            const size_t& _k,
+            const std::vector<int>& _weights = {}
+        ): Engine(_dataset, _h, _h, _eps, _weights), threshold(_threshold), k(_k), order(selectivity_order(_dataset, _eps)),
+            // A risk 1/c is at least t when c is at most 1/t
+            limit(_threshold > 0 ? count_limit(_threshold) : INT_MAX - 1) {}
+
+        float assess_risk(size_t i, short h) const override {
+            Record& u = dataset[i];
+            size_t counted = 0, visited = 0;
+            // Dispatches the common sizes to the specialized path
+            int matches = dispatch_fixed(h, u.features.size(), [&](auto H) {
+                return decide_fixed<decltype(H)::value>(u, counted, visited);
+            }, [&]() {
+                return decide_generic(u, h, counted, visited);
+            });
+            counters.add(counted, visited);
+            if (matches > limit.load(std::memory_order_relaxed))
+                return 0;
+            // No match at all means a risk of 1 or more, depending on the other combinations
+            if (threshold > 0)
+                return matches > 0 ? 1.0 / matches : 1.0;
+            std::unique_lock<std::mutex> lock(heap_mutex);
+            heap.push(matches);
+            if (heap.size() > k)
+                heap.pop();
+            if (heap.size() == k && heap.top() < limit.load(std::memory_order_relaxed))
+                limit.store(heap.top(), std::memory_order_relaxed);
+            return 1.0 / matches;
+        }
+
+        /**
+         * @brief Work saved by the bounded counts of the decisions.
+         */
+        std::string report() const override {
+            return counters.report(dataset.size());
+        }
+    };
+
+    /**
+     * @brief Writes the users selected by a decision engine, one row per user: the ones with a
+     * risk of at least the threshold, with a lower bound of the risk, or the k riskiest ones,
+     * from the riskiest, with their risk.
+     *
+     * @param dataset Dataset to read the usernames.
+     * @param risks Risks of the decision engine, 0 for the users not selected.
+     * @param threshold Risk threshold, 0 for the top-k mode.
+     * @param k Number of users to write in top-k mode.
+     * @param output_stream Stream to write data on a file.
+     */
+    inline void write_selected(
+        const std::vector<Record>& dataset,
+        const std::vector<float>& risks,
+        const float& threshold,
+        const size_t& k,
+        std::ofstream& output_stream
+    ) {
+        std::vector<size_t> selected;
+        for (size_t i = 0; i < dataset.size(); i++)
+            if (risks[i] > 0)
+                selected.push_back(i);
+        if (threshold > 0)
+            output_stream << "ID,Risk_at_least" << std::endl;
+        else {
+            output_stream << "ID,Risk" << std::endl;
+            // The riskiest first, ties in file order
+            auto riskier = [&risks](const size_t& a, const size_t& b) {
+                return risks[a] > risks[b] || (risks[a] == risks[b] && a < b);
+            };
+            size_t count = std::min(k, selected.size());
+            std::partial_sort(selected.begin(), selected.begin() + count, selected.end(), riskier);
+            selected.resize(count);
+        }
+        for (size_t i: selected)
+            output_stream << dataset[i].id << "," << risks[i] << std::endl;
+    }
+} // namespace prudence
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+#include <prudence/columnar.hpp>
+#include <prudence/engine.hpp>
+#include <prudence/simd.hpp>
+
+namespace prudence {
+    /**
+     * @brief Engine that evaluates a block of users against a cache-sized block of candidates
+     * for a block of combinations before moving to the next candidate block. Every candidate
+     * block is then loaded once per (user block, combination block) instead of once per
+     * (user, combination), which raises the arithmetic intensity of the scan.
+     * Per-user counters and flags carry the state across the blocks: a user leaves the
+     * computation as soon as it has risk 1, and a (user, combination) pair stops counting as
+     * soon as it can neither be a single match nor lower the user's minimum.
+     */
+    class TiledEngine: public Engine {
+    private:
+        // Bytes of candidate columns that should stay in the cache
+        static constexpr size_t CACHE_BYTES = 256 * 1024;
+        // Columnar copy of the dataset
+        ColumnarDataset columns;
+        // Kernel that counts the matches on a candidate block
+        match_kernel kernel;
+        // Number of users in a block
+        size_t user_block;
+        // Number of candidates in a block, a multiple of 16
+        size_t candidate_block;
+        // Number of combinations in a block
+        size_t combination_block;
+
+        /**
+         * @brief Computes the risks of a block of users for one background knowledge size.
+         * 
+         * @param begin Index of the first user.
+         * @param end Index after the last user.
+         * @param h Background knowledge size.
+         * @param risks Risk of the first user, the others follow at distance stride.
+         * @param stride Distance between the risks of two users.
+         * @param skip If not null, the users for which the risk is already known to be 1.
+         */
+        void assess_block(
+            const size_t& begin,
+            const size_t& end,
+            const short& h,
+            float* risks,
+            const size_t& stride,
+            const std::vector<bool>* skip
+        ) const {
+            size_t users = end - begin;
+            size_t m = columns.features();
+            const int* w = weights.empty() ? nullptr : weights.data();
+            // Minimum number of matches for a combination, per user
+            std::vector<int> min_matches(users, INT_MAX);
+            // True if the user has a combination with a single match
+            std::vector<bool> single(users, false);
+            if (skip)
+                single = *skip;
+            // Selected features of the combinations of the current block
+            std::vector<size_t> selected;
+            selected.reserve(combination_block * h);
+            // Match counters and liveness flags, per (user, combination)
+            std::vector<int> counts(users * combination_block);
+            std::vector<bool> alive(users * combination_block);
+            CombinationsEnumerator comb(m, h);
+            bool more = true;
+            while (more) {
+                // Collects the next block of combinations
+                selected.clear();
+                size_t combinations = 0;
+                do {
+                    for (size_t j = 0, k = 0; j < comb.mask.size() && k < (size_t) h; j++)
+                        if (comb.mask[j]) {
+                            selected.push_back(j);
+                            k++;
+                        }
+                    combinations++;
+                    more = comb.next();
+                } while (more && combinations < combination_block);
+                // Pads the combinations that have less than h features (h > m)
+                selected.resize(combinations * h, 0);
+                bool any = false;
+                for (size_t u = 0; u < users; u++) {
+                    std::fill_n(counts.begin() + u * combination_block, combinations, 0);
+                    std::fill_n(alive.begin() + u * combination_block, combinations, !single[u]);
+                    any = any || !single[u];
+                }
+                if (!any)
+                    break;
+                // Streams the candidate blocks
+                for (size_t vb = 0; vb < columns.size(); vb += candidate_block) {
+                    size_t ve = std::min(vb + candidate_block, columns.size());
+                    for (size_t u = 0; u < users; u++) {
+                        if (single[u])
+                            continue;
+                        const float* values = dataset[begin + u].features.data();
+                        for (size_t c = 0; c < combinations; c++) {
+                            size_t k = u * combination_block + c;
+                            if (!alive[k])
+                                continue;
+                            counts[k] += kernel(columns, values, &selected[c * h], h, eps, w, vb, ve);
+                            // Can be neither a single match nor a new minimum
+                            if (counts[k] >= std::max(min_matches[u], 2))
+                                alive[k] = false;
+                        }
+                    }
+                }
+                // Folds the counts of the block in the per-user state
+                for (size_t u = 0; u < users; u++)
+                    for (size_t c = 0; c < combinations && !single[u]; c++) {
+                        size_t k = u * combination_block + c;
+                        if (!alive[k])
+                            continue;
+                        if (counts[k] == 1)
+                            single[u] = true;
+                        else
+                            min_matches[u] = std::min(min_matches[u], counts[k]);
+                    }
+            }
+            for (size_t u = 0; u < users; u++)
+                // Risk is the inverse of the minimum number of matches
+                risks[u * stride] = single[u] ? 1.0 : 1.0 / min_matches[u];
+        }
+    public:
+        /**
+         * @brief Construct a new tiled engine object.
+         * 
+         * @param _dataset Global view of the dataset.
+         * @param _h_min Smallest background knowledge size.
+         * @param _h_max Largest background knowledge size.
+         * @param _eps Epsilon margin for the matching.
+         * @param _kernel Kernel that counts the matches on a candidate block.
+         * @param _weights Number of original records represented by each record, empty if all are 1.
+         */
+        TiledEngine(
+            std::vector<Record>& _dataset,
+            const short& _h_min,
+            const short& _h_max,
+            const float& _eps,
+            match_kernel _kernel,
+            const std::vector<int>& _weights = {}
+        ):
+            Engine(_dataset, _h_min, _h_max, _eps, _weights),
+            columns(_dataset),
+            kernel(_kernel),
+            user_block(32),
+            candidate_block(std::max<size_t>(16, CACHE_BYTES / (sizeof(float) * std::max<size_t>(columns.features(), 1)) / 16 * 16)),
+            combination_block(64) {}
+
+        float assess_risk(size_t i, short h) const override {
+            float risk;
+            assess_block(i, i + 1, h, &risk, 1, nullptr);
+            return risk;
+        }
+
+        void assess_risks(size_t i, float* risks) const override {
+            assess_range(i, i + 1, risks);
+        }
+
+        /**
+         * @brief Splits the range in user blocks and computes every size on each block.
+         */
+        void assess_range(size_t begin, size_t end, float* risks) const override {
+            size_t width = this->width();
+            for (size_t b = begin; b < end; b += user_block) {
+                size_t e = std::min(end, b + user_block);
+                float* block = risks + (b - begin) * width;
+                // Users with risk 1 that keep it for larger sizes
+                std::vector<bool> skip(e - b, false);
+                for (short h = h_min; h <= h_max; h++) {
+                    size_t l = h - h_min;
+                    assess_block(b, e, h, block + l, width, &skip);
+                    for (size_t u = 0; u < e - b; u++)
+                        skip[u] = block[u * width + l] == 1.0 && self_match(b + u);
+                }
+            }
+        }
+    };
+} // namespace prudence
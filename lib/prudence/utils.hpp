@@ -2,6 +2,7 @@
 
 #include <climits>
 #include <fstream>
+#include <type_traits>
 #include <vector>
 
 #include <prudence/record.hpp>
@@ -41,6 +42,33 @@ namespace prudence {
             output_stream << dataset[i].id << "," << risks[i] << std::endl;
     }
 
+    /**
+     * @brief Writes a risk matrix, with one column per computed risk, to the output stream.
+     * 
+     * @param dataset Dataset to read the usernames.
+     * @param risks Matrix of risks, stored row by row.
+     * @param columns Names of the risk columns.
+     * @param output_stream Stream to write data on a file.
+     */
+    inline void write_risk(
+        const std::vector<Record>& dataset,
+        const std::vector<float>& risks,
+        const std::vector<std::string>& columns,
+        std::ofstream& output_stream
+    ) {
+        // Writes the header
+        output_stream << "ID";
+        for (const std::string& column: columns)
+            output_stream << "," << column;
+        output_stream << std::endl;
+        for (size_t i = 0; i < dataset.size(); i++) {
+            output_stream << dataset[i].id;
+            for (size_t l = 0; l < columns.size(); l++)
+                output_stream << "," << risks[i * columns.size() + l];
+            output_stream << std::endl;
+        }
+    }
+
     /**
      * @brief Computes the number of matches for the record u in the dataset.
      * 
@@ -49,45 +77,102 @@ namespace prudence {
      * @param h Background knowledge size.
      * @param eps Margin of the matching.
      * @param mask Boolean mask representing the indices that have to be taken into account.
-     * @return int Number of matches of u.
+     * @param weights Number of original records represented by each record, empty if all are 1.
+     * @param bound The count stops as soon as it reaches this value.
+     * @param checked If not null, incremented by the number of candidates checked.
+     * @return int Number of matches of u, or a value not smaller than bound.
      */
     static int matches_combination(
         Record& u,
         const std::vector<Record>& dataset,
         const float& eps,
-        const std::vector<bool>& mask
+        const std::vector<bool>& mask,
+        const std::vector<int>& weights = {},
+        const int& bound = INT_MAX,
+        size_t* checked = nullptr
     ) {
         int matches = 0;
-        for (const Record& v: dataset)
-            matches += u.matches(v, eps, mask);
+        size_t v = 0;
+        if (weights.empty()) {
+            for (; v < dataset.size() && matches < bound; v++)
+                matches += u.matches(dataset[v], eps, mask);
+        }
+        else {
+            for (; v < dataset.size() && matches < bound; v++)
+                if (u.matches(dataset[v], eps, mask))
+                    matches += weights[v];
+        }
+        if (checked)
+            *checked += v;
         return matches;
     }
 
     /**
-     * @brief Assesses the risk of a record in a dataset
+     * @brief Computes the number of matches for the record u on a combination of exactly H features.
      * 
+     * @tparam H Background knowledge size.
+     * @param u User's record.
+     * @param dataset Global view of the dataset.
+     * @param eps Margin of the matching.
+     * @param selected Indices of the features that have to be taken into account.
+     * @param weights Number of original records represented by each record, empty if all are 1.
+     * @param bound The count stops as soon as it reaches this value.
+     * @param checked If not null, incremented by the number of candidates checked.
+     * @return int Number of matches of u, or a value not smaller than bound.
+     */
+    template <size_t H>
+    int matches_combination(
+        const Record& u,
+        const std::vector<Record>& dataset,
+        const float& eps,
+        const std::array<uint8_t, H>& selected,
+        const std::vector<int>& weights,
+        const int& bound = INT_MAX,
+        size_t* checked = nullptr
+    ) {
+        int matches = 0;
+        size_t v = 0;
+        if (weights.empty()) {
+            for (; v < dataset.size() && matches < bound; v++)
+                matches += u.matches<H>(dataset[v], eps, selected);
+        }
+        else {
+            for (; v < dataset.size() && matches < bound; v++)
+                if (u.matches<H>(dataset[v], eps, selected))
+                    matches += weights[v];
+        }
+        if (checked)
+            *checked += v;
+        return matches;
+    }
+
+    /**
+     * @brief Assesses the risk of a record in a dataset, with the background knowledge size
+     * known at compile time.
+     * 
+     * @tparam H Background knowledge size.
      * @param u User's record.
      * @param dataset Global view of the dataset.
-     * @param h Background knowledge size.
      * @param eps Epsilon margin for the match.
+     * @param weights Number of original records represented by each record, empty if all are 1.
      * @return float Risk for the user.
      */
-    float assess_risk(
-        Record& u,
+    template <size_t H>
+    float assess_risk_fixed(
+        const Record& u,
         const std::vector<Record>& dataset,
-        const short& h,
-        const float& eps
+        const float& eps,
+        const std::vector<int>& weights
     ) {
         // Minimum number of matches for a combination
         int min_matches = INT_MAX;
-        CombinationsEnumerator comb(u.features.size(), h);
+        FixedCombinationsEnumerator<H> comb(u.features.size());
         do {
             // Number of matches for the combination
-            int matches = matches_combination(u, dataset, eps, comb.mask);
+            int matches = matches_combination<H>(u, dataset, eps, comb.indices, weights);
             // If we have only 1 match the combination gives the risk
-            if (matches == 1) {
+            if (matches == 1)
                 return 1.0;
-            }
             // Else we take the minimum number of matches found
             if (matches < min_matches)
                 min_matches = matches;
@@ -96,6 +181,72 @@ namespace prudence {
         return 1.0 / min_matches;
     }
 
+    /**
+     * @brief Dispatches the common background knowledge sizes to a path specialized at compile
+     * time, and the others to the generic one.
+     * 
+     * @param h Background knowledge size.
+     * @param m Number of features.
+     * @param fixed Specialized path, called with std::integral_constant<size_t, h>.
+     * @param generic Generic path, called without arguments.
+     * @return The result of the path taken.
+     */
+    template <typename Fixed, typename Generic>
+    auto dispatch_fixed(const short& h, const size_t& m, Fixed&& fixed, Generic&& generic) {
+        if (m <= 256 && (size_t) h <= m)
+            switch (h) {
+                case 1: return fixed(std::integral_constant<size_t, 1>());
+                case 2: return fixed(std::integral_constant<size_t, 2>());
+                case 3: return fixed(std::integral_constant<size_t, 3>());
+                case 4: return fixed(std::integral_constant<size_t, 4>());
+                case 5: return fixed(std::integral_constant<size_t, 5>());
+                case 6: return fixed(std::integral_constant<size_t, 6>());
+                case 7: return fixed(std::integral_constant<size_t, 7>());
+                case 8: return fixed(std::integral_constant<size_t, 8>());
+            }
+        return generic();
+    }
+
+    /**
+     * @brief Assesses the risk of a record in a dataset
+     * 
+     * @param u User's record.
+     * @param dataset Global view of the dataset.
+     * @param h Background knowledge size.
+     * @param eps Epsilon margin for the match.
+     * @param weights Number of original records represented by each record, empty if all are 1.
+     * @return float Risk for the user.
+     */
+    float assess_risk(
+        Record& u,
+        const std::vector<Record>& dataset,
+        const short& h,
+        const float& eps,
+        const std::vector<int>& weights = {}
+    ) {
+        // Dispatches the common sizes to the specialized path
+        return dispatch_fixed(h, u.features.size(), [&](auto H) {
+            return assess_risk_fixed<decltype(H)::value>(u, dataset, eps, weights);
+        }, [&]() {
+            // Minimum number of matches for a combination
+            int min_matches = INT_MAX;
+            CombinationsEnumerator comb(u.features.size(), h);
+            do {
+                // Number of matches for the combination
+                int matches = matches_combination(u, dataset, eps, comb.mask, weights);
+                // If we have only 1 match the combination gives the risk
+                if (matches == 1) {
+                    return 1.0f;
+                }
+                // Else we take the minimum number of matches found
+                if (matches < min_matches)
+                    min_matches = matches;
+            } while (comb.next());
+            // Risk is the inverse of the minimum number of matches
+            return (float) (1.0 / min_matches);
+        });
+    }
+
     /**
      * @brief Computes the PRUDEnce algorithm in a sequential manner.
      * 
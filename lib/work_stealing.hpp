@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <entities.hpp>
+#include <prudence/engine.hpp>
+
+/**
+ * @brief Double ended queue of chunks owned by one worker. The owner pushes and pops at the
+ * back, thieves steal from the front, where the largest chunks are.
+ */
+class WorkDeque {
+private:
+    std::mutex mut;
+    std::deque<chunk_t> chunks;
+public:
+    /**
+     * @brief Pushes a chunk at the back of the deque.
+     * 
+     * @param chunk Chunk to push.
+     */
+    void push(const chunk_t& chunk) {
+        std::lock_guard<std::mutex> lock(mut);
+        chunks.push_back(chunk);
+    }
+
+    /**
+     * @brief Pops the most recent chunk, used by the owner.
+     * 
+     * @param chunk Chunk popped from the deque.
+     * @return true If the deque was non-empty.
+     * @return false Otherwise.
+     */
+    bool pop(chunk_t& chunk) {
+        std::lock_guard<std::mutex> lock(mut);
+        if (chunks.empty())
+            return false;
+        chunk = chunks.back();
+        chunks.pop_back();
+        return true;
+    }
+
+    /**
+     * @brief Steals the oldest chunk, used by the other workers.
+     * 
+     * @param chunk Chunk stolen from the deque.
+     * @return true If the deque was non-empty.
+     * @return false Otherwise.
+     */
+    bool steal(chunk_t& chunk) {
+        std::lock_guard<std::mutex> lock(mut);
+        if (chunks.empty())
+            return false;
+        chunk = chunks.front();
+        chunks.pop_front();
+        return true;
+    }
+};
+
+/**
+ * @brief Pool of workers that balance the users with randomized work stealing.
+ * Each worker starts from an equal share of the users and splits its chunks recursively,
+ * keeping the first half and exposing the second one, until the chunk is below the grain size.
+ * An idle worker steals from a random victim, so no central entity is involved.
+ */
+class WorkStealingPool {
+private:
+    // Engine that computes the risk
+    const prudence::Engine& engine;
+    // Matrix of risk values, one row per user
+    std::vector<float>& risk_vector;
+    // Deque of each worker
+    std::vector<WorkDeque> deques;
+    // Largest chunk computed without splitting
+    size_t grain;
+    // Number of users not computed yet
+    std::atomic<size_t> remaining;
+
+    /**
+     * @brief Body of a worker: computes its chunks, then steals until all users are computed.
+     * 
+     * @param id Identifier of the worker.
+     */
+    void work(const thread_id id) {
+        short nw = deques.size();
+        // Generator of the victims
+        std::minstd_rand generator(id + 1);
+        std::uniform_int_distribution<short> victims(0, nw - 1);
+        chunk_t chunk = { 0, 0 };
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            bool found = deques[id].pop(chunk);
+            // Tries every other worker, starting from a random one
+            for (short k = 0, v = victims(generator); !found && k < nw; k++, v = (v + 1) % nw)
+                if (v != id)
+                    found = deques[v].steal(chunk);
+            if (!found) {
+                std::this_thread::yield();
+                continue;
+            }
+            // Exposes the second half until the chunk fits in the grain
+            while (chunk.end - chunk.begin > grain) {
+                size_t middle = chunk.begin + (chunk.end - chunk.begin) / 2;
+                deques[id].push({ middle, chunk.end });
+                chunk.end = middle;
+            }
+            // Computes the risk on the chunk
+            engine.assess_range(chunk.begin, chunk.end, risk_vector.data() + chunk.begin * engine.width());
+            remaining.fetch_sub(chunk.end - chunk.begin, std::memory_order_acq_rel);
+        }
+    }
+public:
+    /**
+     * @brief Construct a new work stealing pool object.
+     * 
+     * @param _engine Engine that computes the risk.
+     * @param _risk_vector Vector in which to put the risk values.
+     * @param nw Number of workers.
+     * @param _grain Largest chunk computed without splitting, 0 to choose it from n and nw.
+     * @param checkpoint If not null, the shares hold equal numbers of its unfinished users.
+     */
+    WorkStealingPool(
+        const prudence::Engine& _engine,
+        std::vector<float>& _risk_vector,
+        const short& nw,
+        const size_t& _grain,
+        const prudence::Checkpoint* checkpoint = nullptr
+    ):
+        engine(_engine),
+        risk_vector(_risk_vector),
+        deques(nw),
+        grain(_grain),
+        remaining(0) {
+        // Users to compute, and positions of the shares mapped to indices
+        size_t n = checkpoint ? checkpoint->unfinished() : _risk_vector.size() / _engine.width();
+        auto index = [&checkpoint](const size_t& position) {
+            return checkpoint ? checkpoint->index(position) : position;
+        };
+        // By default, about 32 chunks per worker
+        if (grain == 0)
+            grain = std::max<size_t>(1, n / (32 * nw));
+        // Assigns an equal share of the users to each worker
+        for (short i = 0; i < nw; i++) {
+            size_t begin = index(n * i / nw), end = index(n * (i + 1) / nw);
+            if (begin < end) {
+                deques[i].push({ begin, end });
+                remaining.fetch_add(end - begin);
+            }
+        }
+    }
+
+    /**
+     * @brief Runs the workers and waits for all of them.
+     */
+    void run() {
+        std::vector<std::thread> threads;
+        for (thread_id i = 0; i < (thread_id) deques.size(); i++)
+            threads.emplace_back(&WorkStealingPool::work, this, i);
+        for (std::thread& t: threads)
+            t.join();
+    }
+};
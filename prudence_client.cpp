@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include <prudence/daemon.hpp>
+
+#include <utimer.hpp>
+
+/**
+ * @brief Prints the usage string of the client.
+ */
+static void print_client_usage(const char* program) {
+    std::cerr << "Usage: " << program << " socket queries [connections=1] [batch=1] [h=-] [eps=-] [--whatif] [--shutdown]" << std::endl;
+}
+
+/**
+ * @brief Sends a request and waits for the reply.
+ * 
+ * @return true If the reply starts with "OK".
+ * @return false If it is an error or the daemon is gone.
+ */
+static bool request(const int& fd, prudence::LineReader& reader, const std::string& line, std::string& reply) {
+    std::string message = line + "\n";
+    return prudence::send_all(fd, message.data(), message.size()) && reader.next(reply) && reply.rfind("OK", 0) == 0;
+}
+
+/**
+ * @brief Connects to the daemon, waiting for it to start listening.
+ */
+static int connect_daemon(const std::string& path) {
+    for (int attempt = 0; attempt < 100; attempt++) {
+        int fd = prudence::connect_unix(path);
+        if (fd >= 0)
+            return fd;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return -1;
+}
+
+int main(int argc, char const *argv[]) {
+    // Positional arguments and flags
+    std::vector<std::string> positional;
+    bool whatif = false, shutdown_daemon = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--whatif")
+            whatif = true;
+        else if (arg == "--shutdown")
+            shutdown_daemon = true;
+        else
+            positional.push_back(arg);
+    }
+    if (positional.size() < 2 || positional.size() > 6) {
+        print_client_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::string path = positional[0];
+    size_t queries = strtoul(positional[1].c_str(), NULL, 10);
+    size_t connections = std::max<size_t>(positional.size() > 2 ? strtoul(positional[2].c_str(), NULL, 10) : 1, 1);
+    size_t batch = std::max<size_t>(positional.size() > 3 ? strtoul(positional[3].c_str(), NULL, 10) : 1, 1);
+    std::string parameters = (positional.size() > 4 ? positional[4] : "-") + " " + (positional.size() > 5 ? positional[5] : "-");
+    // Size of the dataset, asked to the daemon
+    size_t users;
+    {
+        int fd = connect_daemon(path);
+        if (fd < 0) {
+            std::cerr << argv[0] << " was unable to connect to " << path << std::endl;
+            return EXIT_FAILURE;
+        }
+        prudence::LineReader reader(fd);
+        std::string reply;
+        if (!request(fd, reader, "INFO", reply)) {
+            std::cerr << argv[0] << ": " << reply << std::endl;
+            return EXIT_FAILURE;
+        }
+        users = strtoul(reply.c_str() + 3, NULL, 10);
+        close(fd);
+    }
+    // Latency of every request in microseconds, by connection
+    std::vector<std::vector<double>> latencies(connections);
+    // Number of failed requests
+    std::atomic<size_t> errors{ 0 };
+    // Time spent sending the queries
+    long total_time;
+    {
+        UTimer timer(&total_time);
+        std::vector<std::thread> clients;
+        for (size_t c = 0; c < connections; c++)
+            clients.emplace_back([&, c]() {
+                int fd = connect_daemon(path);
+                if (fd < 0) {
+                    errors++;
+                    return;
+                }
+                prudence::LineReader reader(fd);
+                std::mt19937_64 random(c);
+                std::uniform_int_distribution<size_t> user(0, users - 1);
+                std::string reply;
+                for (size_t q = queries * c / connections; q < queries * (c + 1) / connections; q++) {
+                    std::string line;
+                    if (whatif) {
+                        // A hypothetical record close to an existing user
+                        if (!request(fd, reader, "RECORD #" + std::to_string(user(random)), reply)) {
+                            errors++;
+                            continue;
+                        }
+                        line = "WHATIF " + parameters + " " + reply.substr(3);
+                    }
+                    else {
+                        line = (batch == 1 ? "RISK " : "BATCH ") + parameters;
+                        for (size_t k = 0; k < batch; k++)
+                            line += " #" + std::to_string(user(random));
+                    }
+                    auto start = std::chrono::steady_clock::now();
+                    bool valid = request(fd, reader, line, reply);
+                    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+                    if (!valid)
+                        errors++;
+                    latencies[c].push_back(elapsed.count());
+                }
+                close(fd);
+            });
+        for (std::thread& client: clients)
+            client.join();
+    }
+    if (shutdown_daemon) {
+        int fd = connect_daemon(path);
+        prudence::LineReader reader(fd);
+        std::string reply;
+        if (fd < 0 || !request(fd, reader, "SHUTDOWN", reply))
+            errors++;
+        close(fd);
+    }
+    // Percentiles of the latency
+    std::vector<double> all;
+    for (const std::vector<double>& latency: latencies)
+        all.insert(all.end(), latency.begin(), latency.end());
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](const double& p) {
+        return all.empty() ? 0.0 : all[std::min(all.size() - 1, (size_t) (p * all.size()))];
+    };
+    std::cout << "Time: " << total_time / 1000.0 << " Queries: " << all.size()
+              << " Throughput: " << all.size() * 1e6 / std::max(total_time, 1L) << " q/s"
+              << " p50: " << percentile(0.5) << " p90: " << percentile(0.9) << " p99: " << percentile(0.99)
+              << " Max: " << (all.empty() ? 0.0 : all.back()) << " us Errors: " << errors << std::endl;
+    return errors == 0 ? 0 : EXIT_FAILURE;
+}
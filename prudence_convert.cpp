@@ -0,0 +1,36 @@
+#include <iostream>
+
+#include <prudence/loader.hpp>
+
+#include <utimer.hpp>
+
+int main(int argc, char const *argv[]) {
+    // Checks the CLI parameters size
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " input_filename output_filename [id_index=0]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    // If provided, id_index
+    int id_index = (argc >= 4) ? strtol(argv[3], NULL, 10) : 0;
+    // Dataset
+    std::vector<prudence::Record> dataset;
+    // Names of the features
+    std::vector<std::string> feature_names;
+    // Size of the input file in bytes
+    size_t input_bytes;
+    // Time spent in the conversion
+    long convert_time;
+    {
+        UTimer timer(&convert_time);
+        if (!prudence::load_dataset(argv[1], id_index, std::thread::hardware_concurrency(), dataset, input_bytes, &feature_names)) {
+            std::cerr << argv[0] << " was unable to read input file " << argv[1] << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!prudence::write_binary_dataset(argv[2], dataset, feature_names)) {
+            std::cerr << argv[0] << " was unable to write output file " << argv[2] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::cout << "Time: " << convert_time / 1000.0 << " Records: " << dataset.size() << " Features: " << feature_names.size() << std::endl;
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <iostream>
+
+#include <prudence/daemon.hpp>
+#include <prudence/loader.hpp>
+#include <prudence/options.hpp>
+
+#include <utimer.hpp>
+
+// Daemon to stop on SIGINT and SIGTERM
+static prudence::Daemon* running = nullptr;
+
+int main(int argc, char const *argv[]) {
+    // Parses the CLI parameters, the output being the path of the socket
+    prudence::Options options;
+    if (!prudence::parse_options(argc, argv, options))
+        return EXIT_FAILURE;
+    if (options.eps_values.size() > 1) {
+        std::cerr << argv[0] << ": a list of epsilon values is not supported" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (options.checkpoint > 0 || options.resume) {
+        std::cerr << argv[0] << ": --checkpoint and --resume are not supported" << std::endl;
+        return EXIT_FAILURE;
+    }
+    // Dataset
+    std::vector<prudence::Record> dataset;
+    // Size of the input file in bytes
+    size_t input_bytes;
+    // Time spent loading the dataset
+    long load_time;
+    {
+        UTimer timer(&load_time);
+        if (!prudence::load_dataset(options.input, options.id_index, std::max<short>(options.nw, 1), dataset, input_bytes)) {
+            std::cerr << argv[0] << " was unable to open input file " << options.input << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    prudence::match_kernel kernel = prudence::select_kernel(options.simd);
+    if (!kernel) {
+        std::cerr << "Kernel " << options.simd << " is unknown or not supported by this CPU" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (dataset.empty() || (size_t) options.h > dataset[0].features.size()) {
+        std::cerr << argv[0] << ": the default background knowledge size exceeds the features" << std::endl;
+        return EXIT_FAILURE;
+    }
+    // Resident dataset
+    prudence::RiskIndex index(std::move(dataset), kernel);
+    prudence::Daemon daemon(index, options.nw, options.h, options.eps);
+    running = &daemon;
+    signal(SIGINT, [](int) { running->interrupt(); });
+    signal(SIGTERM, [](int) { running->interrupt(); });
+    std::cerr << argv[0] << ": serving " << index.size() << " users on " << options.output << std::endl;
+    // Time spent serving
+    long serve_time;
+    {
+        UTimer timer(&serve_time);
+        if (!daemon.serve(options.output)) {
+            std::cerr << argv[0] << " was unable to listen on " << options.output << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::cout << "Time: " << serve_time / 1000.0 << " Load: " << (double) input_bytes / std::max(load_time, 1L) << " MB/s"
+              << " Queries: " << daemon.queries << std::endl;
+    return 0;
+}
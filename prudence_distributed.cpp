@@ -0,0 +1,108 @@
+#include <iostream>
+#include <limits>
+
+#include <prudence/distributed.hpp>
+
+#include <utimer.hpp>
+
+int main(int argc, char const *argv[]) {
+    // Worker mode, started by the coordinator with its end of the socket
+    if (argc == 2 && std::string(argv[1]).rfind("--worker=", 0) == 0)
+        return prudence::run_worker(strtol(argv[1] + 9, NULL, 10), argv[0]);
+    // Parses the CLI parameters
+    prudence::Options options;
+    if (!prudence::parse_options(argc, argv, options))
+        return EXIT_FAILURE;
+    // Number of worker processes to use
+    short nw = options.nw;
+    // Dataset
+    std::vector<prudence::Record> dataset;
+    // Names of the features, needed to ship the dataset
+    std::vector<std::string> feature_names;
+    // Size of the input file in bytes
+    size_t input_bytes;
+    // Time spent loading the dataset
+    long load_time;
+    {
+        UTimer timer(&load_time);
+        if (!prudence::load_dataset(options.input, options.id_index, std::max<short>(nw, 1), dataset, input_bytes, &feature_names)) {
+            std::cerr << argv[0] << " was unable to open input file " << options.input << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    // If requested, collapses the records with identical features into weighted groups
+    prudence::DuplicateGroups groups;
+    if (options.dedup)
+        groups = prudence::collapse_duplicates(dataset);
+    // Records on which the risk is computed
+    std::vector<prudence::Record>& records = options.dedup ? groups.records : dataset;
+    // Engine that computes the risk, used locally for the sequential run and to check the options
+    std::unique_ptr<prudence::Engine> engine = prudence::make_engine(options, records, groups.weights);
+    if (!engine)
+        return EXIT_FAILURE;
+    // Number of records to compute
+    size_t n = records.size();
+    // Number of risk values of each user
+    size_t width = engine->width();
+    // Matrix of risk values, one row per user
+    std::vector<float> risk_vector(n * width);
+    // Checkpoints of the finished users, restored on resume
+    prudence::Checkpoint checkpoint(options, records, risk_vector, width);
+    if (!checkpoint.restore())
+        return EXIT_FAILURE;
+    engine = checkpoint.track(records, options, std::move(engine));
+    // Time spent in the computation phase, shipping included
+    long comp_time;
+    // Number of failed workers
+    int failures = 0;
+    if (nw == 0) {
+        UTimer timer(&comp_time);
+        sequential_algorithm(*engine, std::ref(risk_vector));
+    }
+    else {
+        UTimer timer(&comp_time);
+        // Options of the workers: same engine, one thread each, dataset already deduplicated
+        std::ostringstream line;
+        // Floats with enough digits to be parsed back to the same value
+        line.precision(std::numeric_limits<float>::max_digits10);
+        line << "1 " << options.h_min << ":" << options.h << " - - ";
+        for (size_t e = 0; e < options.eps_values.size(); e++)
+            line << (e ? "," : "") << options.eps_values[e];
+        line << " 0 --engine=" << options.engine
+             << " --simd=" << options.simd << " --prune=" << options.prune << " --nested=off";
+        if (options.engine == "quantized")
+            line << " --bits=" << (options.bits ? std::to_string(options.bits) : "auto");
+        if (options.validate)
+            line << " --validate";
+        if (options.threshold > 0)
+            line << " --threshold=" << options.threshold;
+        if (options.top > 0)
+            line << " --top=" << options.top;
+        if (options.sample > 0)
+            line << " --sample=" << options.sample << " --sample-combinations=" << options.sample_combinations
+                 << " --seed=" << options.seed << (options.stratified ? " --stratified" : "");
+        prudence::Coordinator coordinator("/proc/self/exe", line.str(), records, feature_names, groups.weights, options.fail);
+        // A few shards per worker, so that a failure loses little work
+        bool done = coordinator.run(nw, 4 * nw, risk_vector, width, checkpoint.enabled() ? &checkpoint : nullptr);
+        failures = coordinator.failures;
+        if (!done) {
+            std::cerr << argv[0] << ": every worker failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    // Gives every original record the risk of its group
+    if (options.dedup)
+        risk_vector = groups.expand(risk_vector, width);
+    // Output stream
+    std::ofstream output_stream(options.output);
+    if (!output_stream.is_open()) {
+        std::cerr << argv[0] << " was unable to open output file " << options.output << std::endl;
+        return EXIT_FAILURE;
+    }
+    prudence::write_output(options, std::ref(dataset), std::ref(risk_vector), *engine, std::ref(output_stream));
+    output_stream.close();
+    checkpoint.finish();
+    std::cout << "Time: " << comp_time / 1000.0 << " Load: " << (double) input_bytes / std::max(load_time, 1L) << " MB/s"
+              << " Failures: " << failures << (checkpoint.enabled() ? checkpoint.report() : "") << std::endl;
+    return 0;
+}
@@ -3,73 +3,109 @@
 #include <ff/ff.hpp>
 #include <ff/parallel_for.hpp>
 
-#include <prudence/utils.hpp>
+#include <prudence/engines.hpp>
+#include <prudence/schedule.hpp>
 
 #include <utimer.hpp>
 
 using namespace ff;
 
 int main(int argc, char const *argv[]) {
-    // Checks the CLI parameters size
-    if (argc < 5) {
-        std::cerr << "Usage: " << argv[0] << " nw h input_filename output_filename [eps=0.3] [id_index=0]" << std::endl;
+    // Parses the CLI parameters
+    prudence::Options options;
+    if (!prudence::parse_options(argc, argv, options))
         return EXIT_FAILURE;
-    }
     // Number of workers to use
-    short nw = (short) strtol(argv[1], NULL, 10);
-    // Background knowledge size
-    short h = (short) strtol(argv[2], NULL, 10);
-    // If provided, epsilon margin
-    float eps = (argc == 6) ? strtof(argv[5], NULL) : 0.3;
-    // If provided, id_index
-    int id_index = (argc == 7) ? strtol(argv[6], NULL, 10) : 0;
-    // Input stream
-    std::ifstream input_stream(argv[3]);
-    if (!input_stream.is_open()) {
-        std::cerr << argv[0] << " was unable to open input file " << argv[3] << std::endl;
-        return EXIT_FAILURE;
+    short nw = options.nw;
+    // Dataset
+    std::vector<prudence::Record> dataset;
+    // Size of the input file in bytes
+    size_t input_bytes;
+    // Time spent loading the dataset
+    long load_time;
+    {
+        UTimer timer(&load_time);
+        // Reads the dataset, parsing with one thread per worker
+        if (!prudence::load_dataset(options.input, options.id_index, std::max<short>(nw, 1), dataset, input_bytes)) {
+            std::cerr << argv[0] << " was unable to open input file " << options.input << std::endl;
+            return EXIT_FAILURE;
+        }
     }
-    // Reads the dataset
-    std::vector<prudence::Record> dataset = prudence::read_dataset(input_stream, id_index);
-    // Closes the input stream
-    input_stream.close();
-    // Number of records in the dataset
-    size_t n = dataset.size();
-    // Array of risk values
-    std::vector<float> risk_vector(n);
+    // If requested, collapses the records with identical features into weighted groups
+    prudence::DuplicateGroups groups;
+    if (options.dedup)
+        groups = prudence::collapse_duplicates(dataset);
+    // If requested, orders the records from the most to the least expensive
+    bool by_cost = options.schedule == "cost";
+    prudence::CostSchedule schedule;
+    if (by_cost)
+        schedule = prudence::schedule_by_cost(options.dedup ? groups.records : dataset, groups.weights, options.eps);
+    // Records on which the risk is computed
+    std::vector<prudence::Record>& records = by_cost ? schedule.records : options.dedup ? groups.records : dataset;
+    // Engine that computes the risk
+    std::unique_ptr<prudence::Engine> engine = prudence::make_engine(options, records, by_cost ? schedule.weights : groups.weights);
+    if (!engine)
+        return EXIT_FAILURE;
+    // Number of records to compute
+    size_t n = records.size();
+    // Number of risk values of each user
+    size_t width = engine->width();
+    // Matrix of risk values, one row per user
+    std::vector<float> risk_vector(n * width);
+    // Checkpoints of the finished users, restored on resume
+    prudence::Checkpoint checkpoint(options, records, risk_vector, width);
+    if (!checkpoint.restore())
+        return EXIT_FAILURE;
+    engine = checkpoint.track(records, options, std::move(engine));
+    // Number of users left to compute
+    size_t p = checkpoint.unfinished();
     // Computation time
     float compute_time;
     // If nw is 0 performs the sequential algorithm
     if (nw == 0) {
         ffTime(START_TIME);
-        sequential_algorithm(std::ref(dataset), h, eps, std::ref(risk_vector));
+        sequential_algorithm(*engine, std::ref(risk_vector));
         compute_time = ffTime(STOP_TIME);
     }
     else {
-        // Chunk size is half of n / nw
-        size_t chunk_size{n / (2 * nw)};
+        // Chunk size is half of p / nw
+        size_t chunk_size{p / (2 * nw)};
         // Parallel for executor
         ParallelFor pf(nw);
         ffTime(START_TIME);
-        pf.parallel_for(0, n, 1, chunk_size, [&dataset, &risk_vector, &h, &eps](const long& i) {
-            // User taken into account
-            prudence::Record& u = dataset[i];
-            // Risk for the user
-            float risk = prudence::assess_risk(u, dataset, h, eps);
-            // Puts the risk in the output vector
-            risk_vector[i] = risk;
-        }, nw);
+        if (by_cost) {
+            // Guided chunks, taken one at a time by the workers
+            std::vector<std::pair<size_t, size_t>> chunks = prudence::guided_chunks(p, nw);
+            pf.parallel_for(0, chunks.size(), 1, 1, [&engine, &risk_vector, &width, &chunks, &checkpoint](const long k) {
+                // Puts the risks of the users of the chunk in the output matrix
+                size_t begin = checkpoint.index(chunks[k].first), end = checkpoint.index(chunks[k].second);
+                engine->assess_range(begin, end, risk_vector.data() + begin * width);
+            }, nw);
+        }
+        else
+            pf.parallel_for_idx(0, p, 1, chunk_size, [&engine, &risk_vector, &width, &checkpoint](const long start, const long stop, const int) {
+                // Puts the risks of the users of the chunk in the output matrix
+                size_t begin = checkpoint.index(start), end = checkpoint.index(stop);
+                engine->assess_range(begin, end, risk_vector.data() + begin * width);
+            }, nw);
         compute_time = ffTime(STOP_TIME);
     }
+    // Brings the risks back to the order of the records
+    if (by_cost)
+        risk_vector = schedule.restore(risk_vector, width);
+    // Gives every original record the risk of its group
+    if (options.dedup)
+        risk_vector = groups.expand(risk_vector, width);
     // Output stream
-    std::ofstream output_stream(argv[4]);
+    std::ofstream output_stream(options.output);
     if (!output_stream.is_open()) {
-        std::cerr << argv[0] << " was unable to open output file " << argv[4] << std::endl;
+        std::cerr << argv[0] << " was unable to open output file " << options.output << std::endl;
         return EXIT_FAILURE;
     }
     // Writes risk vector on disk
-    prudence::write_risk(std::ref(dataset), std::ref(risk_vector), std::ref(output_stream));
+    prudence::write_output(options, std::ref(dataset), std::ref(risk_vector), *engine, std::ref(output_stream));
     output_stream.close();
-    std::cout << "Time: " << compute_time << std::endl;
+    checkpoint.finish();
+    std::cout << "Time: " << compute_time << " Load: " << (double) input_bytes / std::max(load_time, 1L) << " MB/s" << engine->report() << std::endl;
     return 0;
 }
@@ -0,0 +1,98 @@
+#include <iostream>
+#include <unordered_set>
+
+#include <prudence/incremental.hpp>
+#include <prudence/loader.hpp>
+#include <prudence/options.hpp>
+#include <prudence/engine.hpp>
+
+#include <utimer.hpp>
+
+int main(int argc, char const *argv[]) {
+    // Parses the CLI parameters
+    prudence::Options options;
+    if (!prudence::parse_options(argc, argv, options))
+        return EXIT_FAILURE;
+    if (options.eps_values.size() > 1) {
+        std::cerr << argv[0] << ": a list of epsilon values is not supported" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (options.checkpoint > 0 || options.resume) {
+        std::cerr << argv[0] << ": --checkpoint and --resume are not supported" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (options.state.empty()) {
+        std::cerr << argv[0] << ": --state=path is required" << std::endl;
+        return EXIT_FAILURE;
+    }
+    // Number of threads of the full computation
+    int threads = std::max<short>(options.nw, 1);
+    // State with the counts of every user
+    prudence::IncrementalState state;
+    // Records read from the input, the whole dataset or the appended rows
+    std::vector<prudence::Record> records;
+    // Names of the features of the input
+    std::vector<std::string> feature_names;
+    // Size of the input file in bytes
+    size_t input_bytes = 0;
+    // Time spent loading
+    long load_time;
+    {
+        UTimer timer(&load_time);
+        if (options.delta && !state.load(options.state)) {
+            std::cerr << argv[0] << " was unable to read state file " << options.state << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (options.input != "-" && !prudence::load_dataset(options.input, options.id_index, threads, records, input_bytes, &feature_names)) {
+            std::cerr << argv[0] << " was unable to open input file " << options.input << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (options.delta && (state.h_min != options.h_min || state.h_max != options.h || state.eps != options.eps)) {
+        std::cerr << argv[0] << ": the state was computed with h=" << state.h_min << ":" << state.h_max << " eps=" << state.eps << std::endl;
+        return EXIT_FAILURE;
+    }
+    size_t m = options.delta ? state.feature_names.size() : feature_names.size();
+    if (m > prudence::IncrementalState::MAX_FEATURES || (options.input != "-" && !records.empty() && records[0].features.size() != m)) {
+        std::cerr << argv[0] << ": the incremental mode needs the same features, at most " << prudence::IncrementalState::MAX_FEATURES << std::endl;
+        return EXIT_FAILURE;
+    }
+    // IDs of the records to remove
+    std::unordered_set<std::string> removed;
+    if (!options.remove.empty()) {
+        std::vector<prudence::Record> rows;
+        size_t bytes;
+        if (!prudence::load_dataset(options.remove, options.id_index, threads, rows, bytes)) {
+            std::cerr << argv[0] << " was unable to open removal file " << options.remove << std::endl;
+            return EXIT_FAILURE;
+        }
+        for (const prudence::Record& row: rows)
+            removed.insert(row.id);
+    }
+    // Time spent in the computation phase
+    long comp_time;
+    {
+        UTimer timer(&comp_time);
+        if (!options.delta)
+            state.build(records, feature_names, options.h_min, options.h, options.eps, threads);
+        else {
+            state.remove(removed);
+            state.append(records);
+        }
+    }
+    if (!state.save(options.state)) {
+        std::cerr << argv[0] << " was unable to write state file " << options.state << std::endl;
+        return EXIT_FAILURE;
+    }
+    // Output stream
+    std::ofstream output_stream(options.output);
+    if (!output_stream.is_open()) {
+        std::cerr << argv[0] << " was unable to open output file " << options.output << std::endl;
+        return EXIT_FAILURE;
+    }
+    prudence::write_risk(state.dataset, state.risks(), prudence::risk_columns(state.h_min, state.h_max), output_stream);
+    output_stream.close();
+    std::cout << "Time: " << comp_time / 1000.0 << " Load: " << (double) input_bytes / std::max(load_time, 1L) << " MB/s"
+              << " Users: " << state.dataset.size() << " Affected: " << state.affected() << std::endl;
+    return 0;
+}
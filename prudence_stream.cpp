@@ -0,0 +1,61 @@
+#include <iostream>
+
+#include <prudence/options.hpp>
+#include <prudence/stream.hpp>
+
+#include <utimer.hpp>
+
+int main(int argc, char const *argv[]) {
+    // Parses the CLI parameters
+    prudence::Options options;
+    if (!prudence::parse_options(argc, argv, options))
+        return EXIT_FAILURE;
+    if (options.eps_values.size() > 1) {
+        std::cerr << argv[0] << ": a list of epsilon values is not supported" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (options.checkpoint > 0 || options.resume) {
+        std::cerr << argv[0] << ": --checkpoint and --resume are not supported" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (options.dedup) {
+        std::cerr << argv[0] << ": --dedup needs the whole dataset in memory" << std::endl;
+        return EXIT_FAILURE;
+    }
+    // Two readers on the same file, one for the users and one for the candidates
+    std::unique_ptr<prudence::BlockReader> users = prudence::open_block_reader(options.input, options.id_index);
+    std::unique_ptr<prudence::BlockReader> candidates = prudence::open_block_reader(options.input, options.id_index);
+    if (!users || !candidates) {
+        std::cerr << argv[0] << " was unable to open input file " << options.input << std::endl;
+        return EXIT_FAILURE;
+    }
+    prudence::match_kernel kernel = prudence::select_kernel(options.simd);
+    if (!kernel) {
+        std::cerr << "Kernel " << options.simd << " is unknown or not supported by this CPU" << std::endl;
+        return EXIT_FAILURE;
+    }
+    // Output stream
+    std::ofstream output_stream(options.output);
+    if (!output_stream.is_open()) {
+        std::cerr << argv[0] << " was unable to open output file " << options.output << std::endl;
+        return EXIT_FAILURE;
+    }
+    prudence::StreamEvaluator evaluator(
+        *users, *candidates, options.h_min, options.h, options.eps, options.nw, kernel, options.memory << 20
+    );
+    // Time spent in the computation, reading included
+    long comp_time;
+    bool done;
+    {
+        UTimer timer(&comp_time);
+        done = evaluator.run(output_stream);
+    }
+    if (!done) {
+        std::cerr << argv[0] << ": the memory budget of " << options.memory << " MB is too small" << std::endl;
+        return EXIT_FAILURE;
+    }
+    output_stream.close();
+    std::cout << "Time: " << comp_time / 1000.0 << " Read: " << (double) (users->bytes + candidates->bytes) / std::max(comp_time, 1L)
+              << " MB/s Users: " << evaluator.user_block << " Candidates: " << evaluator.candidate_block << std::endl;
+    return 0;
+}
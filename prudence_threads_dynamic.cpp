@@ -1,82 +1,90 @@
 #include <iostream>
-#include <thread>
 
 #include <entities.hpp>
+#include <prudence/engines.hpp>
 
 #include <utimer.hpp>
 
 int main(int argc, char const *argv[]) {
-    // Checks the CLI parameters size
-    if (argc < 5) {
-        std::cerr << "Usage: " << argv[0] << " nw h input_filename output_filename [eps=0.3] [id_index=0]" << std::endl;
+    // Parses the CLI parameters
+    prudence::Options options;
+    if (!prudence::parse_options(argc, argv, options))
         return EXIT_FAILURE;
-    }
     // Number of workers to use
-    short nw = (short) strtol(argv[1], NULL, 10);
-    // Background knowledge size
-    short h = (short) strtol(argv[2], NULL, 10);
-    // If provided, epsilon margin
-    float eps = (argc == 6) ? strtof(argv[5], NULL) : 0.3;
-    // If provided, id_index
-    int id_index = (argc == 7) ? strtol(argv[6], NULL, 10) : 0;
-    // Input stream
-    std::ifstream input_stream(argv[3]);
-    if (!input_stream.is_open()) {
-        std::cerr << argv[0] << " was unable to open input file " << argv[3] << std::endl;
-        return EXIT_FAILURE;
+    short nw = options.nw;
+    // Dataset
+    std::vector<prudence::Record> dataset;
+    // Size of the input file in bytes
+    size_t input_bytes;
+    // Time spent loading the dataset
+    long load_time;
+    {
+        UTimer timer(&load_time);
+        // Reads the dataset, parsing with one thread per worker
+        if (!prudence::load_dataset(options.input, options.id_index, std::max<short>(nw, 1), dataset, input_bytes)) {
+            std::cerr << argv[0] << " was unable to open input file " << options.input << std::endl;
+            return EXIT_FAILURE;
+        }
     }
-    // Reads the dataset
-    std::vector<prudence::Record> dataset = prudence::read_dataset(input_stream, id_index);
-    // Closes the input stream
-    input_stream.close();
-    // Number of records in the dataset
-    size_t n = dataset.size();
-    // Array of risk values
-    std::vector<float> risk_vector(n);
+    // If requested, collapses the records with identical features into weighted groups
+    prudence::DuplicateGroups groups;
+    if (options.dedup)
+        groups = prudence::collapse_duplicates(dataset);
+    // If requested, orders the records from the most to the least expensive
+    bool by_cost = options.schedule == "cost";
+    prudence::CostSchedule schedule;
+    if (by_cost)
+        schedule = prudence::schedule_by_cost(options.dedup ? groups.records : dataset, groups.weights, options.eps);
+    // Records on which the risk is computed
+    std::vector<prudence::Record>& records = by_cost ? schedule.records : options.dedup ? groups.records : dataset;
+    // Engine that computes the risk
+    std::unique_ptr<prudence::Engine> engine = prudence::make_engine(options, records, by_cost ? schedule.weights : groups.weights);
+    if (!engine)
+        return EXIT_FAILURE;
+    // Number of records to compute
+    size_t n = records.size();
+    // Number of risk values of each user
+    size_t width = engine->width();
+    // Matrix of risk values, one row per user
+    std::vector<float> risk_vector(n * width);
+    // Checkpoints of the finished users, restored on resume
+    prudence::Checkpoint checkpoint(options, records, risk_vector, width);
+    if (!checkpoint.restore())
+        return EXIT_FAILURE;
+    engine = checkpoint.track(records, options, std::move(engine));
     // Time spent in the computation phase
     long comp_time;
+    // Overheads of the emitter and of the queues
+    farm_stats_t stats;
     // If nw is 0 performs the sequential algorithm
     if (nw == 0) {
         UTimer timer(&comp_time);
-        sequential_algorithm(std::ref(dataset), h, eps, std::ref(risk_vector));
+        sequential_algorithm(*engine, std::ref(risk_vector));
     }
     else {
-        // Vector of queues
-        std::vector<SafeQueue<std::optional<chunk_t>>> queues(nw);
-        // Feedback queue
-        SafeQueue<thread_id> feedback_queue;
-        // Vector of threads
-        std::vector<std::thread> worker_threads(nw);
         // Timer that cronometrates the latency
         UTimer timer(&comp_time);
-        for (thread_id i = 0; i < nw; i++) {
-            // Worker thread
-            std::thread worker_thread(
-                worker,
-                i,
-                std::ref(dataset),
-                std::ref(risk_vector),
-                std::ref(queues[i]),
-                std::ref(feedback_queue),
-                h,
-                eps
-            );
-            worker_threads[i] = std::move(worker_thread);
-        }
-        // To spare a thread, the main thread becomes the emitter
-        emitter(std::ref(queues), std::ref(feedback_queue), n);
-        // Joins all the entities
-        for (std::thread& w: worker_threads)
-            w.join();
+        if (options.queue == "lockfree")
+            stats = farm<SpscQueue<std::optional<chunk_t>>, MpscQueue<thread_id>>(*engine, risk_vector, nw, by_cost, &checkpoint);
+        else
+            stats = farm<SafeQueue<std::optional<chunk_t>>, SafeQueue<thread_id>>(*engine, risk_vector, nw, by_cost, &checkpoint);
     }
+    // Brings the risks back to the order of the records
+    if (by_cost)
+        risk_vector = schedule.restore(risk_vector, width);
+    // Gives every original record the risk of its group
+    if (options.dedup)
+        risk_vector = groups.expand(risk_vector, width);
     // Output stream
-    std::ofstream output_stream(argv[4]);
+    std::ofstream output_stream(options.output);
     if (!output_stream.is_open()) {
-        std::cerr << argv[0] << " was unable to open output file " << argv[4] << std::endl;
+        std::cerr << argv[0] << " was unable to open output file " << options.output << std::endl;
         return EXIT_FAILURE;
     }
-    prudence::write_risk(std::ref(dataset), std::ref(risk_vector), std::ref(output_stream));
+    prudence::write_output(options, std::ref(dataset), std::ref(risk_vector), *engine, std::ref(output_stream));
     output_stream.close();
-    std::cout << "Time: " << comp_time / 1000.0 << std::endl;
+    checkpoint.finish();
+    std::cout << "Time: " << comp_time / 1000.0 << " Load: " << (double) input_bytes / std::max(load_time, 1L) << " MB/s"
+              << " Emitter: " << stats.emitter << " us Handoff: " << stats.handoff << " us" << engine->report() << std::endl;
     return 0;
 }
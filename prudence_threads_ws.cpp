@@ -0,0 +1,79 @@
+#include <iostream>
+#include <thread>
+
+#include <work_stealing.hpp>
+#include <prudence/engines.hpp>
+
+#include <utimer.hpp>
+
+int main(int argc, char const *argv[]) {
+    // Parses the CLI parameters
+    prudence::Options options;
+    if (!prudence::parse_options(argc, argv, options))
+        return EXIT_FAILURE;
+    // Number of workers to use
+    short nw = options.nw;
+    // Dataset
+    std::vector<prudence::Record> dataset;
+    // Size of the input file in bytes
+    size_t input_bytes;
+    // Time spent loading the dataset
+    long load_time;
+    {
+        UTimer timer(&load_time);
+        // Reads the dataset, parsing with one thread per worker
+        if (!prudence::load_dataset(options.input, options.id_index, std::max<short>(nw, 1), dataset, input_bytes)) {
+            std::cerr << argv[0] << " was unable to open input file " << options.input << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    // If requested, collapses the records with identical features into weighted groups
+    prudence::DuplicateGroups groups;
+    if (options.dedup)
+        groups = prudence::collapse_duplicates(dataset);
+    // Records on which the risk is computed
+    std::vector<prudence::Record>& records = options.dedup ? groups.records : dataset;
+    // Engine that computes the risk
+    std::unique_ptr<prudence::Engine> engine = prudence::make_engine(options, records, groups.weights);
+    if (!engine)
+        return EXIT_FAILURE;
+    // Number of records to compute
+    size_t n = records.size();
+    // Number of risk values of each user
+    size_t width = engine->width();
+    // Matrix of risk values, one row per user
+    std::vector<float> risk_vector(n * width);
+    // Checkpoints of the finished users, restored on resume
+    prudence::Checkpoint checkpoint(options, records, risk_vector, width);
+    if (!checkpoint.restore())
+        return EXIT_FAILURE;
+    engine = checkpoint.track(records, options, std::move(engine));
+    // Time spent in the computation phase
+    long comp_time;
+    // If nw is 0 performs the sequential algorithm
+    if (nw == 0) {
+        UTimer timer(&comp_time);
+        sequential_algorithm(*engine, std::ref(risk_vector));
+    }
+    else {
+        // Pool of workers with a deque each
+        WorkStealingPool pool(*engine, risk_vector, nw, options.grain, &checkpoint);
+        // Timer that cronometrates the latency
+        UTimer timer(&comp_time);
+        pool.run();
+    }
+    // Gives every original record the risk of its group
+    if (options.dedup)
+        risk_vector = groups.expand(risk_vector, width);
+    // Output stream
+    std::ofstream output_stream(options.output);
+    if (!output_stream.is_open()) {
+        std::cerr << argv[0] << " was unable to open output file " << options.output << std::endl;
+        return EXIT_FAILURE;
+    }
+    prudence::write_output(options, std::ref(dataset), std::ref(risk_vector), *engine, std::ref(output_stream));
+    output_stream.close();
+    checkpoint.finish();
+    std::cout << "Time: " << comp_time / 1000.0 << " Load: " << (double) input_bytes / std::max(load_time, 1L) << " MB/s" << engine->report() << std::endl;
+    return 0;
+}